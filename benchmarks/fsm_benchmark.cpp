@@ -0,0 +1,371 @@
+/*
+Benchmarks of the stepping throughput and of the construction cost of the machines.
+
+For every machine size, number of inputs and transition style, the machine is stepped with random inputs
+for a fixed amount of time and the number of steps per second and of heap allocations per step are reported.
+The transition styles are:
+- names   : the lambdas look the inputs and the next state up by name, as in the examples;
+- ids     : the lambdas index the inputs directly and return ids;
+- handles : handle based transition functions;
+- compiled: the same machine, compiled into a transition table;
+- recorded: the compiled machine with a transition_recorder attached;
+- profiled: the compiled machine with a transition_profiler attached, sampling one step every 64;
+- run     : the compiled machine, driven by moore_fsm::run over a whole input trace;
+- stream  : the compiled machine, driven by moore_fsm::run_stream over the same trace, bit packed;
+- bank    : 1024 instances of the compiled machine in a moore_fsm_bank (steps of a single instance);
+- bitslice: 1024 instances of the compiled machine in a moore_fsm_bitsliced_bank (steps of a single instance, only for the small machine);
+- static  : a static_moore_fsm (only for the small machine).
+The construction of the machines, run_events against run over a trace whose inputs rarely change, and the snapshots
+of the run state of a large moore_fsm_bank are measured as well.
+
+Build with "make benchmarks" and run "./build/fsm_benchmark" ("--quick" for a shorter run).
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstdlib>
+#include <atomic>
+#include <new>
+#include <string>
+#include <vector>
+#include <memory>
+#include "fsmlib.hpp"
+
+using namespace std;
+
+//Counting allocator: every allocation made by the program goes through here
+static atomic<size_t> num_allocations{0};
+
+void* operator new(size_t size){
+    num_allocations.fetch_add(1, memory_order_relaxed);
+    if(void* p = malloc(size == 0 ? 1 : size))
+        return p;
+    throw bad_alloc();
+}
+void operator delete(void* p) noexcept {free(p);}
+void operator delete(void* p, size_t) noexcept {free(p);}
+
+//Benchmark parameters
+static double min_seconds = 0.3;
+
+//Every benchmark adds its state here, so that the compiler can't drop the stepping
+static volatile size_t sink;
+
+struct result{
+    double steps_per_second;
+    double allocations_per_step;
+};
+
+//Deterministic pseudo random generator, so that every style sees the same inputs
+struct xorshift{
+    uint64_t state = 88172645463325252ull;
+    uint64_t operator()(){
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+};
+
+//Next state of the benchmark machines: a fixed pseudo random graph
+static size_t next_of(const size_t& state_id, const size_t& encoded_inputs, const size_t& num_states){
+    return (state_id * 2654435761u + encoded_inputs * 40503u + 7) % num_states;
+}
+
+//Average duration of fn, called repeatedly until min_seconds have passed
+template<typename fn_t>
+static double measure_seconds(fn_t fn){
+    size_t num_calls = 0;
+    const auto start = chrono::steady_clock::now();
+    double seconds = 0;
+    do {
+        fn();
+        ++num_calls;
+        seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    } while(seconds < min_seconds);
+
+    return seconds / num_calls;
+}
+
+//Calls step(inputs) with fresh random inputs until min_seconds have passed
+template<typename step_fn_t>
+static result measure(const size_t& num_inputs, step_fn_t step){
+    xorshift rng;
+    vector<size_t> inputs(num_inputs);
+    vector<vector<size_t>> input_pool(4096, inputs);
+    for(auto& in : input_pool)
+        for(auto& value : in)
+            value = rng() & 1;
+
+    size_t num_steps = 0;
+    size_t batch = 1024;
+    const auto allocations_before = num_allocations.load();
+    const auto start = chrono::steady_clock::now();
+    double elapsed = 0;
+    while(elapsed < min_seconds){
+        for(size_t i = 0; i < batch; ++i)
+            step(input_pool[(num_steps + i) & 4095]);
+        num_steps += batch;
+        batch *= 2;
+        elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+    const auto allocations = num_allocations.load() - allocations_before;
+
+    return {num_steps / elapsed, static_cast<double>(allocations) / num_steps};
+}
+
+static void print_result(const string& benchmark, const size_t& num_states, const size_t& num_inputs, const string& style, const result& r){
+    cout << left << setw(12) << benchmark
+         << right << setw(8) << num_states << setw(8) << num_inputs << "  "
+         << left << setw(10) << style
+         << right << setw(14) << fixed << setprecision(2) << r.steps_per_second / 1e6
+         << setw(14) << setprecision(3) << r.allocations_per_step << endl;
+}
+
+//Builds the benchmark machine with one of the transition styles
+static moore_fsm make_machine(const size_t& num_states, const size_t& num_inputs, const string& style){
+    moore_fsm fsm{num_inputs, 1, num_states};
+    for(size_t i = 0; i < num_inputs; ++i){
+        fsm.set_input_name(i, "in" + to_string(i));
+        fsm.set_input_alphabet_size(i, 2);
+    }
+
+    auto input_names = make_shared<vector<string>>();
+    for(size_t i = 0; i < num_inputs; ++i)
+        input_names->push_back("in" + to_string(i));
+    auto state_names = make_shared<vector<string>>();
+    for(size_t s = 0; s < num_states; ++s)
+        state_names->push_back("s" + to_string(s));
+
+    for(size_t s = 0; s < num_states; ++s){
+        if(style == "names")
+            fsm.add_state((*state_names)[s], {s & 1}, [=]tr_lamba -> size_t{
+                size_t encoded = 0;
+                for(size_t i = 0; i < input_names->size(); ++i)
+                    encoded |= inputs[name_to_input_id.at((*input_names)[i])] << i;
+                return name_to_state_id.at((*state_names)[next_of(s, encoded, num_states)]);
+            });
+        else if(style == "ids")
+            fsm.add_state((*state_names)[s], {s & 1}, [=]tr_lamba -> size_t{
+                size_t encoded = 0;
+                for(size_t i = 0; i < inputs.size(); ++i)
+                    encoded |= inputs[i] << i;
+                return next_of(s, encoded, num_states);
+            });
+        else
+            fsm.add_state((*state_names)[s], {s & 1}, [=](input_view inputs) -> size_t{
+                size_t encoded = 0;
+                for(size_t i = 0; i < inputs.size(); ++i)
+                    encoded |= inputs[i] << i;
+                return next_of(s, encoded, num_states);
+            });
+    }
+
+    fsm.set_current_state(0);
+    return fsm;
+}
+
+//Small machine known at compile time, the same as make_machine(16, 1, ...)
+constexpr auto static_table = make_static_fsm_table<16, 2, 1, 1>({2},
+    [](size_t state_id) -> array<size_t, 1>{return {state_id & 1};},
+    [](size_t state_id, const array<size_t, 1>& inputs) -> size_t{return (state_id * 2654435761u + inputs[0] * 40503u + 7) % 16;});
+
+static void stepping_benchmarks(){
+    const vector<size_t> state_counts = {16, 1024, 65536};
+    const vector<size_t> input_widths = {1, 4, 8};
+
+    cout << left << setw(12) << "benchmark" << right << setw(8) << "states" << setw(8) << "inputs" << "  "
+         << left << setw(10) << "style" << right << setw(14) << "Msteps/s" << setw(14) << "allocs/step" << endl;
+
+    for(const auto& num_states : state_counts){
+        for(const auto& num_inputs : input_widths){
+            for(const string style : {"names", "ids", "handles"}){
+                auto fsm = make_machine(num_states, num_inputs, style);
+                print_result("step", num_states, num_inputs, style, measure(num_inputs, [&](const vector<size_t>& in){
+                    fsm.set_inputs(in);
+                    sink = fsm.step_machine();
+                }));
+            }
+
+            auto fsm = make_machine(num_states, num_inputs, "ids");
+            fsm.compile();
+            print_result("step", num_states, num_inputs, "compiled", measure(num_inputs, [&](const vector<size_t>& in){
+                fsm.set_inputs(in);
+                sink = fsm.step_machine();
+            }));
+
+            //The same, recording every transition into a ring buffer
+            transition_recorder recorder(65536, num_inputs);
+            fsm.attach_recorder(recorder);
+            print_result("step", num_states, num_inputs, "recorded", measure(num_inputs, [&](const vector<size_t>& in){
+                fsm.set_inputs(in);
+                sink = fsm.step_machine();
+            }));
+            fsm.detach_recorder();
+
+            //The same, counting the visits and sampling one step every 64 into a profiler
+            transition_profiler profiler(64);
+            fsm.attach_profiler(profiler);
+            print_result("step", num_states, num_inputs, "profiled", measure(num_inputs, [&](const vector<size_t>& in){
+                fsm.set_inputs(in);
+                sink = fsm.step_machine();
+            }));
+            fsm.detach_profiler();
+
+            //Whole traces of 4096 steps, reported per step
+            vector<size_t> trace;
+            xorshift rng;
+            for(size_t i = 0; i < 4096 * num_inputs; ++i)
+                trace.push_back(rng() & 1);
+            vector<size_t> state_trace(4096);
+            auto r = measure(num_inputs, [&](const vector<size_t>&){
+                sink = fsm.run(trace, state_trace);
+            });
+            r.steps_per_second *= 4096;
+            r.allocations_per_step /= 4096;
+            print_result("run", num_states, num_inputs, "compiled", r);
+
+            //The same trace, bit packed and streamed from memory, reported per step
+            vector<byte> packed_trace(trace.size() / 8);
+            for(size_t i = 0; i < trace.size(); ++i)
+                packed_trace[i / 8] |= static_cast<byte>(trace[i] << (i % 8));
+            size_t streamed_steps;
+            r = measure(num_inputs, [&](const vector<size_t>&){
+                fsm.run_stream(packed_trace, {1, 0}, trace_mode::states, [](span<const size_t> results){sink = results.back(); return 0;}, streamed_steps);
+            });
+            r.steps_per_second *= 4096;
+            r.allocations_per_step /= 4096;
+            print_result("stream", num_states, num_inputs, "compiled", r);
+
+            //1024 instances stepped together, reported per instance step
+            moore_fsm_bank bank(fsm, 1024);
+            for(size_t i = 0; i < bank.get_num_instances(); ++i)
+                bank.set_encoded_inputs(i, rng() % fsm.get_num_encoded_inputs());
+            r = measure(num_inputs, [&](const vector<size_t>&){
+                bank.step_all();
+                sink = bank.get_current_state_id(0);
+            });
+            r.steps_per_second *= bank.get_num_instances();
+            r.allocations_per_step /= bank.get_num_instances();
+            print_result("bank", num_states, num_inputs, "compiled", r);
+
+            //1024 instances bitsliced in 16 words of 64 channels, reported per instance step.
+            //The cost of a step grows with the number of states times 2^inputs, so only the small machine is measured.
+            if(num_states == 16){
+                moore_fsm_bitsliced_bank bitsliced_bank(fsm, 1024);
+                for(size_t w = 0; w < bitsliced_bank.get_num_words(); ++w)
+                    for(size_t i = 0; i < num_inputs; ++i)
+                        bitsliced_bank.set_input_word(w, i, rng());
+                r = measure(num_inputs, [&](const vector<size_t>&){
+                    bitsliced_bank.step_all();
+                    sink = bitsliced_bank.get_output_word(0, 0);
+                });
+                r.steps_per_second *= bitsliced_bank.get_num_instances();
+                r.allocations_per_step /= bitsliced_bank.get_num_instances();
+                print_result("bitslice", num_states, num_inputs, "compiled", r);
+            }
+
+            if(num_states == 16 && num_inputs == 1){
+                static_moore_fsm<static_table> static_fsm;
+                print_result("step", num_states, num_inputs, "static", measure(num_inputs, [&](const vector<size_t>& in){
+                    static_fsm.set_input(0, in[0]);
+                    sink = static_fsm.step_machine();
+                }));
+            }
+        }
+    }
+}
+
+static void construction_benchmarks(){
+    cout << endl << left << setw(12) << "benchmark" << right << setw(8) << "states" << setw(16) << "ns/add_state" << setw(18) << "ns/set_state_name" << endl;
+
+    for(const size_t num_states : {1000, 10000, 100000}){
+        moore_fsm fsm{1, 1};
+        auto start = chrono::steady_clock::now();
+        for(size_t s = 0; s < num_states; ++s)
+            fsm.add_state("s" + to_string(s), {0}, [](input_view) -> size_t{return 0;});
+        const auto add_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        start = chrono::steady_clock::now();
+        for(size_t s = 0; s < num_states; ++s)
+            fsm.set_state_name(s, "renamed" + to_string(s));
+        const auto rename_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        cout << left << setw(12) << "construct" << right << setw(8) << num_states
+             << setw(16) << fixed << setprecision(1) << add_seconds * 1e9 / num_states
+             << setw(18) << rename_seconds * 1e9 / num_states << endl;
+    }
+}
+
+static void event_benchmarks(){
+    cout << endl << left << setw(12) << "benchmark" << right << setw(8) << "states" << "  " << left << setw(10) << "style"
+         << right << setw(14) << "Msteps/s run" << setw(18) << "Msteps/s events" << setw(10) << "elided" << endl;
+
+    //Pulse counter: the state only moves when the input is 1, and the input is 1 about once every 64 steps
+    xorshift rng;
+    vector<size_t> trace(1 << 16);
+    for(auto& in : trace)
+        in = (rng() & 63) == 0;
+    vector<size_t> state_trace(trace.size());
+
+    for(const bool compiled : {false, true}){
+        moore_fsm fsm{1, 1};
+        const size_t num_states = 16;
+        for(size_t s = 0; s < num_states; ++s)
+            fsm.add_state({s & 1}, [=](input_view inputs) -> size_t{return inputs[0] != 0 ? (s + 1) % num_states : s;});
+        fsm.set_current_state(0);
+        fsm.set_input_alphabet_size(0, 2);
+        if(compiled)
+            fsm.compile();
+
+        size_t num_elided_steps = 0;
+        const auto run_seconds = measure_seconds([&]{sink = fsm.run(trace, state_trace);});
+        const auto events_seconds = measure_seconds([&]{sink = fsm.run_events(trace, state_trace, trace_mode::states, num_elided_steps);});
+
+        cout << left << setw(12) << "events" << right << setw(8) << num_states << "  " << left << setw(10) << (compiled ? "compiled" : "handles")
+             << right << setw(14) << fixed << setprecision(2) << trace.size() / run_seconds / 1e6
+             << setw(18) << trace.size() / events_seconds / 1e6
+             << setw(9) << setprecision(1) << 100.0 * num_elided_steps / trace.size() << "%" << endl;
+    }
+}
+
+static void snapshot_benchmarks(){
+    cout << endl << left << setw(12) << "benchmark" << right << setw(10) << "instances" << setw(12) << "ms/save" << setw(12) << "ms/load" << setw(10) << "GB/s" << endl;
+
+    //Run state of a bank of 1M instances, saved into and restored from a preallocated buffer
+    auto fsm = make_machine(1024, 4, "ids");
+    fsm.compile();
+    moore_fsm_bank bank(fsm, 1 << 20);
+    bank.step_all();
+    vector<byte> buffer(bank.get_snapshot_size());
+
+    constexpr size_t repetitions = 20;
+    auto start = chrono::steady_clock::now();
+    for(size_t k = 0; k < repetitions; ++k)
+        bank.save_snapshot(buffer);
+    const auto save_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count() / repetitions;
+
+    start = chrono::steady_clock::now();
+    for(size_t k = 0; k < repetitions; ++k)
+        bank.load_snapshot(buffer);
+    const auto load_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count() / repetitions;
+
+    cout << left << setw(12) << "snapshot" << right << setw(10) << bank.get_num_instances()
+         << setw(12) << fixed << setprecision(3) << save_seconds * 1e3 << setw(12) << load_seconds * 1e3
+         << setw(10) << setprecision(2) << buffer.size() / save_seconds / 1e9 << endl;
+}
+
+int main(int argc, char** argv){
+    for(int i = 1; i < argc; ++i){
+        if(string(argv[i]) == "--quick")
+            min_seconds = 0.02;
+    }
+
+    stepping_benchmarks();
+    construction_benchmarks();
+    event_benchmarks();
+    snapshot_benchmarks();
+
+    return 0;
+}
@@ -0,0 +1,44 @@
+/*
+In this example, the fsm detects several words at once in a stream of characters.
+
+Instead of writing the states by hand, as in sequence_detector.cpp, the machine is generated from the list of words
+with moore_fsm::from_patterns. Its input is a character and its outputs are the id + 1 of the longest word ending
+at the current character ("match", 0 if there's none) and the number of words ending there ("num_matches").
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "fsmlib.hpp"
+
+using namespace std;
+
+int main(){
+    const vector<string> words = {"he", "she", "his", "hers"};
+    const string text = "ushers said his share is hers";
+
+    //Every word becomes a pattern of symbols, the alphabet is made of the 256 values of a byte
+    vector<vector<size_t>> patterns;
+    for(const auto& w : words)
+        patterns.emplace_back(w.begin(), w.end());
+
+    vector<size_t> shorter_match;
+    moore_fsm fsm = moore_fsm::from_patterns(patterns, 256, shorter_match);
+    cout << "Machine with " << fsm.get_num_states() << " states for " << words.size() << " words" << endl;
+
+    //Scan the text one character at a time
+    for(size_t i = 0; i < text.size(); ++i){
+        fsm.set_input(0, static_cast<unsigned char>(text[i]));
+        fsm.step_machine();
+
+        //All the words ending here are listed following the links from the longest one
+        if(fsm.get_output("num_matches") != 0){
+            cout << "Position " << i << ":";
+            for(size_t match = fsm.get_output("match"); match != 0; match = shorter_match[match - 1])
+                cout << " \"" << words[match - 1] << "\"";
+            cout << endl;
+        }
+    }
+
+    return 0;
+}
@@ -3,11 +3,174 @@
 
 #include <string>
 #include <vector>
-#include <map>
+#include <unordered_map>
+#include <string_view>
 #include <functional>
+#include <span>
+#include <array>
+#include <type_traits>
+#include <cstdint>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <cstddef>
 
-#define tr_lamba ([[maybe_unused]] auto inputs, [[maybe_unused]] auto name_to_input_id, [[maybe_unused]] auto name_to_state_id)
-using state_transition_fn = std::function<size_t(const std::vector<size_t>& inputs, const std::map<std::string, size_t>& name_to_input_id, const std::map<std::string, size_t>& name_to_state_id)>;
+//Bidirectional table of names: hashed name -> id lookups (also from std::string_view) and dense id -> name lookups.
+//Every id has one name, returned by get_name, and may have more names added as aliases.
+class symbol_table {
+    private:
+        struct name_hash {
+            using is_transparent = void;
+            size_t operator()(std::string_view name) const {return std::hash<std::string_view>{}(name);}
+        };
+
+        std::unordered_map<std::string, size_t, name_hash, std::equal_to<>> name_to_id;
+        std::vector<std::string> id_to_name;    //Empty string if the id has no name
+
+    public:
+        void reserve(const size_t& num_ids);
+        void clear();
+        void set_name(const size_t& id, const std::string& name);
+        void add_alias(const size_t& id, const std::string& name);
+        void remap(const std::vector<size_t>& old_to_new_id, const size_t& new_num_ids);
+
+        bool contains(std::string_view name) const;
+        size_t at(std::string_view name) const;
+        size_t get_id(std::string_view name) const;
+        const std::string& get_name(const size_t& id) const;
+        size_t size() const {return name_to_id.size();}
+
+        auto begin() const {return name_to_id.begin();}
+        auto end() const {return name_to_id.end();}
+};
+
+#define tr_lamba ([[maybe_unused]] const auto& inputs, [[maybe_unused]] const auto& name_to_input_id, [[maybe_unused]] const auto& name_to_state_id)
+using state_transition_fn = std::function<size_t(const std::vector<size_t>& inputs, const symbol_table& name_to_input_id, const symbol_table& name_to_state_id)>;
+
+//Read only view of the inputs, indexed by the input ids, passed to the handle based transition functions
+class input_view {
+    private:
+        const size_t* values;
+        size_t num_values;
+
+    public:
+        input_view(std::span<const size_t> in) : values(in.data()), num_values(in.size()) {}
+        size_t operator[](const size_t& input_id) const {return values[input_id];}
+        size_t size() const {return num_values;}
+};
+
+//Transition function that receives the inputs only and returns the id of the next state.
+//The ids of the inputs and of the states it uses are resolved once, when the machine is built.
+using handle_transition_fn = std::function<size_t(input_view inputs)>;
+
+class fsm_executor;
+
+//What moore_fsm::run writes in the output trace at every step
+enum class trace_mode {
+    states,         //the id of the state reached
+    outputs,        //the outputs of the state reached
+    final_state     //nothing, only the final state is kept
+};
+
+//Layout of the records read by moore_fsm::run_stream.
+//Every record holds the inputs in order, each one field_bits wide (1 to 64) and stored little endian, starting from the least significant bit.
+//A record starts record_bits after the previous one, without any gap: 0 means num_inputs * field_bits, larger values leave unused bits after the inputs.
+struct stream_format {
+    size_t field_bits = 8;
+    size_t record_bits = 0;
+};
+
+//Receives the results of moore_fsm::run_stream, one chunk at a time, in the same layout as the output trace of moore_fsm::run.
+//Returning anything but 0 stops the run.
+using stream_sink_fn = std::function<int(std::span<const size_t> results)>;
+
+//Sink writing every result into the file descriptor fd, as a value_bytes wide little endian integer
+stream_sink_fn make_fd_sink(const int& fd, const size_t& value_bytes);
+
+//Fixed size ring buffer of the last transitions of a machine, see moore_fsm::attach_recorder.
+//Every record is get_record_size() 64 bit words: step, from_state_id, to_state_id (-1 for invalid transitions) and the first num_inputs inputs.
+//A single machine writes into the recorder without locks, while any other thread can read it or dump it at the same time.
+class transition_recorder {
+    private:
+        size_t capacity;
+        size_t num_inputs;
+        size_t record_size;
+        std::unique_ptr<std::atomic<uint64_t>[]> records;
+        std::atomic<uint64_t> num_recorded;     //Records written so far: the next one goes to slot num_recorded % capacity
+        std::string error_dump_path;
+        bool error_dumped;                      //Set by the first invalid transition of a burst, cleared by the next valid one
+
+    public:
+        //---------------------------------------------------------------------------------------
+        //Costructors and destructor
+        transition_recorder(const size_t& capacity, const size_t& num_inputs, const std::string& error_dump_path = "");
+        ~transition_recorder() = default;
+
+        //---------------------------------------------------------------------------------------
+        //Getters of general recorder info
+        size_t get_capacity() const {return capacity;}
+        size_t get_num_inputs() const {return num_inputs;}
+        size_t get_record_size() const {return record_size;}
+        uint64_t get_num_recorded() const {return num_recorded.load(std::memory_order_acquire);}
+
+        //---------------------------------------------------------------------------------------
+        //Recording and reading the transitions
+        void record(const size_t& from_state_id, const size_t& to_state_id, std::span<const size_t> inputs);
+        size_t get_records(std::vector<uint64_t>& out) const;
+        int dump(const std::string& path) const;
+        void clear();
+};
+
+//Counters of the states visited and of the transitions taken by the machines attached to it, see moore_fsm::attach_profiler.
+//Every attached machine counts into its own shard, without locks, and the shards are merged when the counts are read.
+//The visits of every state are counted at every step, while the edges taken and the time spent in the transition functions
+//are only counted once every sampling_period steps, which bounds their cost.
+class transition_profiler {
+    public:
+        struct shard;   //Counters of a single machine
+
+        struct edge_count {
+            size_t from_state_id;
+            size_t to_state_id;     //-1 for invalid transitions
+            uint64_t count;
+        };
+        struct transition_fn_time {
+            size_t state_id;
+            uint64_t calls;
+            uint64_t nanoseconds;
+        };
+
+    private:
+        size_t sampling_period;
+        mutable std::mutex shards_mutex;
+        std::vector<std::unique_ptr<shard>> shards;
+
+        void grow_state_visits(shard& s, const size_t& num_states);
+
+    public:
+        //---------------------------------------------------------------------------------------
+        //Costructors and destructor
+        transition_profiler(const size_t& sampling_period = 1);
+        ~transition_profiler();
+
+        //---------------------------------------------------------------------------------------
+        //Counting, used by the attached machines
+        size_t get_sampling_period() const {return sampling_period;}
+        shard* add_shard(shard* reused = nullptr);
+        void count_visit(shard& s, const size_t& state_id);
+        void count_sample(shard& s, const size_t& from_state_id, const size_t& to_state_id, const bool& timed, const uint64_t& nanoseconds);
+
+        //---------------------------------------------------------------------------------------
+        //Reading the counts
+        std::vector<uint64_t> get_state_visits() const;
+        std::vector<edge_count> get_edge_counts() const;
+        std::vector<transition_fn_time> get_transition_fn_times() const;
+        int export_csv(const std::string& path) const;
+        void clear();
+};
 
 class moore_fsm {
     private:
@@ -16,20 +179,81 @@ class moore_fsm {
 
         size_t current_state_id;
         std::vector<size_t> current_inputs;
-        std::vector<size_t> current_outputs;
+        size_t current_outputs_offset;          //Offset of the current outputs in output_arena
+
+        //Current ids (-1 for the removed states) of the state ids seen by the handle based transition functions defined before
+        //the states were last remapped. Shared by the states defined between the same two remaps.
+        struct state_id_space{
+            std::vector<size_t> to_current_state_id;
+        };
 
         struct state{
-            std::vector<size_t> state_outputs;
             state_transition_fn transition_fn;
+            handle_transition_fn handle_fn;     //Used instead of transition_fn when set
+            std::shared_ptr<const state_id_space> id_space;     //Null when the transition function returns the current ids
             
-            state(const std::vector<size_t>& out, const state_transition_fn& fn) :
-            state_outputs(out), transition_fn(fn) {}
+            state(const state_transition_fn& fn) : transition_fn(fn) {}
+            state(const handle_transition_fn& fn) : handle_fn(fn) {}
         };
         std::vector<state> machine_states;
 
-        std::map<std::string, size_t> name_input_id_map;
-        std::map<std::string, size_t> name_output_id_map;
-        std::map<std::string, size_t> name_state_id_map;
+        //The outputs of all the states, num_outputs values each, one after the other.
+        //The first row is all zeros and holds the outputs before a state is set, the outputs of state_id start at (state_id + 1) * num_outputs.
+        //Stepping only moves current_outputs_offset, without copying the outputs.
+        std::vector<size_t> output_arena;
+
+        symbol_table name_input_id_map;
+        symbol_table name_output_id_map;
+        symbol_table name_state_id_map;
+
+        //Declared alphabet of each input and compiled transition table.
+        //An alphabet size of 0 means that the alphabet of that input has not been declared.
+        //The inputs are encoded in mixed radix: the stride of input 0 is 1, the stride of input i is the product of the alphabet sizes before it.
+        std::vector<size_t> input_alphabet_sizes;
+        std::vector<size_t> input_strides;
+        size_t num_encoded_inputs;
+        std::shared_ptr<const std::vector<size_t>> transition_table;  //next_state = (*transition_table)[state_id * num_encoded_inputs + encoded_inputs], shared between copies
+        bool compiled;
+
+        //Recorder of the transitions of step_machine. Copies of the machine don't inherit it, since a recorder has a single writer.
+        struct attached_recorder {
+            transition_recorder* ptr = nullptr;
+
+            attached_recorder() = default;
+            attached_recorder(const attached_recorder&) {}
+            attached_recorder(attached_recorder&& other) noexcept : ptr(other.ptr) {other.ptr = nullptr;}
+            attached_recorder& operator=(const attached_recorder&) {return *this;}
+            attached_recorder& operator=(attached_recorder&& other) noexcept {ptr = other.ptr; other.ptr = nullptr; return *this;}
+        };
+        attached_recorder recorder;
+
+        //Profiler counting the steps of step_machine, with the same copy rules as the recorder
+        struct attached_profiler {
+            transition_profiler* ptr = nullptr;
+            transition_profiler::shard* counters = nullptr;     //Kept after detaching, to be reused when attaching again
+            size_t countdown = 0;   //Steps to the next sampled one
+
+            attached_profiler() = default;
+            attached_profiler(const attached_profiler&) {}
+            attached_profiler(attached_profiler&& other) noexcept : ptr(other.ptr), counters(other.counters), countdown(other.countdown) {other.ptr = nullptr; other.counters = nullptr;}
+            attached_profiler& operator=(const attached_profiler&) {return *this;}
+            attached_profiler& operator=(attached_profiler&& other) noexcept {ptr = other.ptr; counters = other.counters; countdown = other.countdown; other.ptr = nullptr; other.counters = nullptr; return *this;}
+        };
+        attached_profiler profiler;
+
+        size_t get_profiled_next_state();
+        void remap_states(const std::vector<size_t>& old_to_new_state_id, const size_t& new_num_states);
+
+        size_t call_transition_fn(const size_t& state_id, const std::vector<size_t>& inputs) const;
+        static size_t translate_state_id(const state_id_space& space, const size_t& state_id) {return state_id < space.to_current_state_id.size() ? space.to_current_state_id[state_id] : -1;}
+        size_t get_trace_steps(std::span<const size_t> input_trace, std::span<const size_t> output_trace, const trace_mode& mode) const;
+        size_t run_trace(size_t& state_id, std::span<const size_t> input_trace, std::span<size_t> output_trace, const trace_mode& mode, std::vector<size_t>& scratch_inputs) const;
+        size_t run_trace_events(size_t& state_id, std::span<const size_t> input_trace, std::span<size_t> output_trace, const trace_mode& mode, std::vector<size_t>& scratch_inputs, size_t& num_elided_steps) const;
+        void set_state_outputs(const size_t& state_id, const std::vector<size_t>& outputs);
+        static moore_fsm from_transition_table(const std::vector<size_t>& input_alphabet_sizes, const size_t& num_outputs, const std::vector<size_t>& state_outputs, std::vector<size_t> transition_table,
+                                               const std::vector<std::string>& input_names, const std::vector<std::string>& output_names, const std::vector<std::string>& state_names);
+        int run_stream_records(std::span<const std::byte> data, const size_t& num_records, const stream_format& format, const trace_mode& mode, const stream_sink_fn& sink,
+                               std::vector<size_t>& input_trace, std::vector<size_t>& results);
 
     public:
         //---------------------------------------------------------------------------------------
@@ -46,50 +270,694 @@ class moore_fsm {
         //---------------------------------------------------------------------------------------
         //Getter/setter of I/O
         int set_input(const size_t& id, const size_t& value);
-        int set_input(const std::string& name, const size_t& value);
+        int set_input(std::string_view name, const size_t& value);
         int set_inputs(const std::vector<size_t>& in);
         size_t get_output(const size_t& id) const;
-        size_t get_output(const std::string& name) const;
-        const std::vector<size_t>& get_outputs() const;
+        size_t get_output(std::string_view name) const;
+        std::span<const size_t> get_outputs() const {return std::span<const size_t>(output_arena).subspan(current_outputs_offset, num_outputs);}
+        const std::vector<size_t>& get_inputs() const {return current_inputs;}
+        int set_inputs_packed(const uint64_t& bits);
+        uint64_t get_outputs_packed() const;
 
         //---------------------------------------------------------------------------------------
         //Associating names to inputs
         int set_input_name(const size_t& input_id, const std::string& name);
         std::string get_input_name(const size_t& input_id) const;
-        size_t get_input_id(const std::string& name) const;
+        size_t get_input_id(std::string_view name) const;
 
         //---------------------------------------------------------------------------------------
         //Associating names to outpus
         int set_output_name(const size_t& output_id, const std::string& name);
-        std::string get_output_name(const size_t& output_id);
-        size_t get_output_id(const std::string& name);
+        std::string get_output_name(const size_t& output_id) const;
+        size_t get_output_id(std::string_view name) const;
 
         //---------------------------------------------------------------------------------------
         //Adding and removing states
         size_t add_state(const std::vector<size_t>& outputs, const state_transition_fn& transition_fn);
         size_t add_state(const std::string& name, const std::vector<size_t>& outputs, const state_transition_fn& transition_fn);
-        //int remove_state(const size_t& state_id);
-        //int remove_state(const std::string& name);
+        size_t add_state(const std::vector<size_t>& outputs, const handle_transition_fn& transition_fn);
+        size_t add_state(const std::string& name, const std::vector<size_t>& outputs, const handle_transition_fn& transition_fn);
+        size_t declare_state(const std::string& name);
+        int define_state(const size_t& state_id, const std::vector<size_t>& outputs, const handle_transition_fn& transition_fn);
+        int define_state(const size_t& state_id, const std::vector<size_t>& outputs, const state_transition_fn& transition_fn);
+        int add_states(const std::vector<std::string>& names, const std::vector<std::vector<size_t>>& outputs, const std::vector<state_transition_fn>& transition_fns, std::vector<size_t>& state_ids);
+        int add_states(const std::vector<std::string>& names, const std::vector<std::vector<size_t>>& outputs, const std::vector<handle_transition_fn>& transition_fns, std::vector<size_t>& state_ids);
+        int remove_state(const size_t& state_id, std::vector<size_t>& old_to_new_state_id);
+        int remove_state(std::string_view name, std::vector<size_t>& old_to_new_state_id);
+        int remove_states(std::span<const size_t> state_ids, std::vector<size_t>& old_to_new_state_id);
 
         //---------------------------------------------------------------------------------------
         //Associating names to states
         int set_state_name(const size_t& state_id, const std::string& name);
-        std::string get_state_name(const size_t& state_id);
-        size_t get_state_id(const std::string& name);
+        std::string get_state_name(const size_t& state_id) const;
+        size_t get_state_id(std::string_view name) const;
+        std::span<const size_t> get_state_outputs(const size_t& state_id) const;
 
         //---------------------------------------------------------------------------------------
         //Simulation of the machine
         int set_current_state(const size_t& state_id);
-        int set_current_state(const std::string& name);
+        int set_current_state(std::string_view name);
         size_t get_current_state_id() const;
         std::string get_current_state_name() const;
         size_t step_machine();
         size_t step_machine(const size_t& num_steps);
+        size_t step_machine(const size_t& num_steps, size_t& num_elided_steps);
+        size_t step_machine_packed(const uint64_t& bits);
+        void attach_recorder(transition_recorder& rec) {recorder.ptr = &rec;}
+        void detach_recorder() {recorder.ptr = nullptr;}
+        void attach_profiler(transition_profiler& prof);
+        void detach_profiler() {profiler.ptr = nullptr;}
+        size_t run(std::span<const size_t> input_trace, std::span<size_t> output_trace, const trace_mode& mode = trace_mode::states);
+        size_t run_events(std::span<const size_t> input_trace, std::span<size_t> output_trace, const trace_mode& mode, size_t& num_elided_steps);
+        size_t run_parallel(fsm_executor& executor, std::span<const size_t> input_trace, std::span<size_t> output_trace, const trace_mode& mode = trace_mode::states);
+        size_t get_next_state(const size_t& state_id, const std::vector<size_t>& inputs) const;
+        int run_stream(const int& fd, const stream_format& format, const trace_mode& mode, const stream_sink_fn& sink, size_t& num_steps);
+        int run_stream(std::span<const std::byte> data, const stream_format& format, const trace_mode& mode, const stream_sink_fn& sink, size_t& num_steps);
+        size_t get_next_state(const size_t& state_id, std::span<const size_t> inputs, std::vector<size_t>& scratch_inputs) const;
+
+        //---------------------------------------------------------------------------------------
+        //Compiling the machine into a transition table
+        int set_input_alphabet_size(const size_t& input_id, const size_t& alphabet_size);
+        int set_input_alphabet_size(std::string_view name, const size_t& alphabet_size);
+        size_t get_input_alphabet_size(const size_t& input_id) const;
+        size_t get_num_encoded_inputs() const {return num_encoded_inputs;}
+        size_t encode_inputs(std::span<const size_t> in) const;
+        int compile();
+        void decompile();
+        bool is_compiled() const {return compiled;}
+        bool is_boolean() const;
+        const std::vector<size_t>& get_transition_table() const;
+        static moore_fsm from_transition_table(const std::vector<size_t>& input_alphabet_sizes, const size_t& num_outputs, const std::vector<size_t>& state_outputs, std::vector<size_t> transition_table);
+        static moore_fsm from_patterns(const std::vector<std::vector<size_t>>& patterns, const size_t& alphabet_size);
+        static moore_fsm from_patterns(const std::vector<std::vector<size_t>>& patterns, const size_t& alphabet_size, std::vector<size_t>& shorter_match);
+
+        //---------------------------------------------------------------------------------------
+        //Optimizing the machine
+        int minimize(moore_fsm& minimized, std::vector<size_t>& old_to_new_state_id) const;
+        int renumber_states(std::span<const size_t> sample_trace, std::vector<size_t>& old_to_new_state_id);
+
+        //---------------------------------------------------------------------------------------
+        //Composing machines
+        static int compose(const std::vector<const moore_fsm*>& components, const std::vector<std::string>& prefixes, const size_t& max_states, moore_fsm& product);
 
         //---------------------------------------------------------------------------------------
         //Saving/loading the machine
-        //friend std::string to_string(const moore_fsm& mfsm);
-        //friend moore_fsm from_string(const std::string& str);
+        int save_binary(const std::string& path) const;
+
+        //---------------------------------------------------------------------------------------
+        //Snapshots of the run state
+        size_t get_snapshot_size() const;
+        int save_snapshot(std::span<std::byte> buffer) const;
+        int save_snapshot(const std::string& path) const;
+        int load_snapshot(std::span<const std::byte> buffer);
+        int load_snapshot(const std::string& path);
+
+        friend class mapped_moore_fsm;
+        friend class moore_fsm_reader;
+        friend std::string to_string(const moore_fsm& mfsm);
+        friend moore_fsm from_string(std::string_view str);
+};
+
+//JSON description of a machine, with its names, outputs and transitions as guarded edges.
+//from_string throws std::invalid_argument on malformed descriptions.
+std::string to_string(const moore_fsm& mfsm);
+moore_fsm from_string(std::string_view str);
+
+//Definition of a machine shared between threads and replaced while they run it, read-copy-update style.
+//A published moore_fsm is never modified again: publish swaps in a new one atomically, and the old one is freed
+//when the last moore_fsm_reader holding it moves to the new one.
+class shared_moore_fsm {
+    private:
+        std::atomic<std::shared_ptr<const moore_fsm>> definition;
+        std::atomic<uint64_t> version;          //Number of definitions published, checked by the readers without touching the shared pointer
+
+    public:
+        //---------------------------------------------------------------------------------------
+        //Costructors and destructor
+        shared_moore_fsm(moore_fsm fsm);
+        ~shared_moore_fsm() = default;
+        shared_moore_fsm(const shared_moore_fsm&) = delete;
+        shared_moore_fsm& operator=(const shared_moore_fsm&) = delete;
+
+        //---------------------------------------------------------------------------------------
+        //Publishing and reading the definition
+        void publish(moore_fsm fsm);
+        std::shared_ptr<const moore_fsm> get_definition() const {return definition.load(std::memory_order_acquire);}
+        uint64_t get_version() const {return version.load(std::memory_order_acquire);}
+};
+
+//How a moore_fsm_reader carries its current state over to a new definition
+enum class state_migration {
+    by_name,        //the state with the same name
+    by_id,          //the state with the same id
+    reset           //the current state of the new definition when it was published
+};
+
+//Run state (current state and inputs) of a machine whose definition is a shared_moore_fsm.
+//Stepping only reads the definition held by the reader, without locks or atomics, and a new definition is picked up
+//only by refresh, which is meant to be called between batches of steps. The shared_moore_fsm must outlive its readers.
+class moore_fsm_reader {
+    private:
+        const shared_moore_fsm* source;
+        std::shared_ptr<const moore_fsm> definition;
+        uint64_t version;
+        state_migration migration;
+
+        size_t current_state_id;
+        std::vector<size_t> current_inputs;
+        std::vector<size_t> scratch_inputs;
+
+    public:
+        //---------------------------------------------------------------------------------------
+        //Costructors and destructor
+        moore_fsm_reader(const shared_moore_fsm& source, const state_migration& migration = state_migration::by_name);
+        ~moore_fsm_reader() = default;
+
+        //---------------------------------------------------------------------------------------
+        //Getters of general reader info
+        const moore_fsm& get_definition() const {return *definition;}
+        uint64_t get_version() const {return version;}
+        state_migration get_migration() const {return migration;}
+        void set_migration(const state_migration& mig) {migration = mig;}
+
+        //---------------------------------------------------------------------------------------
+        //Getter/setter of I/O
+        int set_input(const size_t& id, const size_t& value);
+        int set_input(std::string_view name, const size_t& value);
+        int set_inputs(const std::vector<size_t>& in);
+        const std::vector<size_t>& get_inputs() const {return current_inputs;}
+        size_t get_output(const size_t& id) const;
+        size_t get_output(std::string_view name) const;
+        std::span<const size_t> get_outputs() const;
+
+        //---------------------------------------------------------------------------------------
+        //Simulation of the machine
+        int set_current_state(const size_t& state_id);
+        int set_current_state(std::string_view name);
+        size_t get_current_state_id() const {return current_state_id;}
+        std::string get_current_state_name() const;
+        size_t step_machine();
+        size_t step_machine(const size_t& num_steps);
+        size_t run(std::span<const size_t> input_trace, std::span<size_t> output_trace, const trace_mode& mode = trace_mode::states);
+
+        //---------------------------------------------------------------------------------------
+        //Picking up new definitions
+        int refresh();
+};
+
+//Next state and outputs produced by a transition of a mealy_fsm
+struct mealy_transition {
+    size_t next_state;
+    std::vector<size_t> outputs;
+};
+using mealy_transition_fn = std::function<mealy_transition(input_view inputs)>;
+
+//Mealy machine: the outputs are produced by the transitions, not by the states.
+//The inputs must have a finite alphabet, declared at construction, and the machine steps through
+//a flat table holding the next state and the outputs of every (state, encoded inputs) pair.
+class mealy_fsm {
+    private:
+        size_t num_inputs;
+        size_t num_outputs;
+        size_t num_states;
+
+        size_t current_state_id;
+        std::vector<size_t> current_inputs;
+        std::vector<size_t> current_outputs;    //Outputs of the last transition
+
+        std::vector<size_t> input_alphabet_sizes;
+        std::vector<size_t> input_strides;
+        size_t num_encoded_inputs;
+
+        //Entry (state_id, encoded_inputs) is at index state_id * num_encoded_inputs + encoded_inputs.
+        //Invalid transitions have -1 as next state.
+        std::vector<size_t> next_state_table;
+        std::vector<size_t> output_table;       //num_outputs values per entry
+
+        symbol_table name_input_id_map;
+        symbol_table name_output_id_map;
+        symbol_table name_state_id_map;
+
+    public:
+        //---------------------------------------------------------------------------------------
+        //Costructors and destructor
+        mealy_fsm(const std::vector<size_t>& input_alphabet_sizes, const size_t& num_outputs, const size_t& num_states = 0);
+        ~mealy_fsm() = default;
+
+        //---------------------------------------------------------------------------------------
+        //Getters of general machine info
+        size_t get_num_inputs() const {return num_inputs;}
+        size_t get_num_outputs() const {return num_outputs;}
+        size_t get_num_states() const {return num_states;}
+        size_t get_input_alphabet_size(const size_t& input_id) const;
+        size_t get_num_encoded_inputs() const {return num_encoded_inputs;}
+        size_t encode_inputs(std::span<const size_t> in) const;
+
+        //---------------------------------------------------------------------------------------
+        //Getter/setter of I/O
+        int set_input(const size_t& id, const size_t& value);
+        int set_input(std::string_view name, const size_t& value);
+        int set_inputs(const std::vector<size_t>& in);
+        size_t get_output(const size_t& id) const;
+        size_t get_output(std::string_view name) const;
+        const std::vector<size_t>& get_outputs() const {return current_outputs;}
+        const std::vector<size_t>& get_inputs() const {return current_inputs;}
+
+        //---------------------------------------------------------------------------------------
+        //Associating names to inputs
+        int set_input_name(const size_t& input_id, const std::string& name);
+        std::string get_input_name(const size_t& input_id) const;
+        size_t get_input_id(std::string_view name) const;
+
+        //---------------------------------------------------------------------------------------
+        //Associating names to outpus
+        int set_output_name(const size_t& output_id, const std::string& name);
+        std::string get_output_name(const size_t& output_id) const;
+        size_t get_output_id(std::string_view name) const;
+
+        //---------------------------------------------------------------------------------------
+        //Adding states and transitions
+        size_t add_state();
+        size_t add_state(const std::string& name);
+        int set_transition(const size_t& state_id, const std::vector<size_t>& inputs, const size_t& next_state_id, const std::vector<size_t>& outputs);
+        int set_transitions(const size_t& state_id, const mealy_transition_fn& transition_fn);
+
+        //---------------------------------------------------------------------------------------
+        //Associating names to states
+        int set_state_name(const size_t& state_id, const std::string& name);
+        std::string get_state_name(const size_t& state_id) const;
+        size_t get_state_id(std::string_view name) const;
+
+        //---------------------------------------------------------------------------------------
+        //Simulation of the machine
+        int set_current_state(const size_t& state_id);
+        int set_current_state(std::string_view name);
+        size_t get_current_state_id() const {return current_state_id;}
+        std::string get_current_state_name() const;
+        size_t step_machine();
+        size_t step_machine(const size_t& num_steps);
+        size_t run(std::span<const size_t> input_trace, std::span<size_t> output_trace, const trace_mode& mode = trace_mode::states);
+};
+
+//Many instances of the same compiled moore_fsm, stepped in lockstep.
+//The transition table and the outputs of the states are stored once, while every instance only stores
+//its current state id and its encoded inputs, in two contiguous arrays.
+class moore_fsm_bank {
+    private:
+        size_t num_inputs;
+        size_t num_outputs;
+        size_t num_states;
+        size_t num_encoded_inputs;
+
+        //Shared machine definition
+        std::vector<size_t> input_alphabet_sizes;
+        std::vector<size_t> input_strides;
+        std::vector<uint32_t> transition_table;     //Invalid transitions are stored as invalid_state
+        std::vector<size_t> state_outputs;          //num_outputs values per state
+
+        //Per instance state
+        std::vector<uint32_t> current_state_ids;
+        std::vector<uint32_t> current_encoded_inputs;
+
+        static constexpr uint32_t invalid_state = static_cast<uint32_t>(-1);
+
+    public:
+        //---------------------------------------------------------------------------------------
+        //Costructors and destructor
+        moore_fsm_bank(const moore_fsm& fsm, const size_t& num_instances);
+        ~moore_fsm_bank() = default;
+
+        //---------------------------------------------------------------------------------------
+        //Getters of general bank info
+        size_t get_num_instances() const {return current_state_ids.size();}
+        size_t get_num_inputs() const {return num_inputs;}
+        size_t get_num_outputs() const {return num_outputs;}
+        size_t get_num_states() const {return num_states;}
+
+        //---------------------------------------------------------------------------------------
+        //Getter/setter of I/O
+        int set_input(const size_t& instance, const size_t& id, const size_t& value);
+        int set_inputs(const size_t& instance, const std::vector<size_t>& in);
+        int set_encoded_inputs(const size_t& instance, const size_t& encoded_inputs);
+        size_t get_input(const size_t& instance, const size_t& id) const;
+        size_t get_output(const size_t& instance, const size_t& id) const;
+        std::span<const size_t> get_outputs(const size_t& instance) const;
+
+        //---------------------------------------------------------------------------------------
+        //Simulation of the instances
+        int set_current_state(const size_t& instance, const size_t& state_id);
+        int set_all_current_states(const size_t& state_id);
+        size_t get_current_state_id(const size_t& instance) const;
+        std::span<const uint32_t> get_current_state_ids() const {return current_state_ids;}
+        void step_all();
+        void step_all(const size_t& num_steps);
+
+        //---------------------------------------------------------------------------------------
+        //Snapshots of the run state
+        size_t get_snapshot_size() const;
+        int save_snapshot(std::span<std::byte> buffer) const;
+        int save_snapshot(const std::string& path) const;
+        int load_snapshot(std::span<const std::byte> buffer);
+        int load_snapshot(const std::string& path);
+};
+
+//Many instances of the same compiled boolean moore_fsm (every input has an alphabet of size 2 and every output is 0 or 1), stepped bitslice style.
+//The instances are grouped in words of 64 channels: bit c of every word of a group belongs to instance 64 * word + c.
+//Every group stores one word per bit of the state id, per input and per output, and a step computes the next state of all its 64 channels
+//with bitwise operations over the transition table, so the cost of a step grows with num_states * 2^num_inputs and the bank suits small machines.
+class moore_fsm_bitsliced_bank {
+    private:
+        size_t num_inputs;
+        size_t num_outputs;
+        size_t num_states;
+        size_t num_encoded_inputs;
+        size_t num_state_bits;
+        size_t num_instances;
+        size_t num_words;
+
+        //Shared machine definition. Invalid transitions are stored as self loops, so they keep the current state.
+        std::vector<uint32_t> transition_table;
+        std::vector<uint64_t> state_output_bits;    //Bit o is output o of the state
+
+        //Per group planes: state bit b of group w is state_planes[w * num_state_bits + b], and the same for inputs and outputs
+        std::vector<uint64_t> state_planes;
+        std::vector<uint64_t> input_planes;
+        std::vector<uint64_t> output_planes;
+
+        //Scratch space of step_all: channels in every state (2^num_state_bits entries), channels with every input combination
+        //and channels reaching every state
+        std::vector<uint64_t> state_masks;
+        std::vector<uint64_t> input_masks;
+        std::vector<uint64_t> next_state_masks;
+
+        void compute_state_masks(const size_t& word);
+        void update_planes(const size_t& word, const std::vector<uint64_t>& masks);
+
+    public:
+        //---------------------------------------------------------------------------------------
+        //Costructors and destructor
+        moore_fsm_bitsliced_bank(const moore_fsm& fsm, const size_t& num_instances);
+        ~moore_fsm_bitsliced_bank() = default;
+
+        //---------------------------------------------------------------------------------------
+        //Getters of general bank info
+        size_t get_num_instances() const {return num_instances;}
+        size_t get_num_words() const {return num_words;}
+        size_t get_num_inputs() const {return num_inputs;}
+        size_t get_num_outputs() const {return num_outputs;}
+        size_t get_num_states() const {return num_states;}
+
+        //---------------------------------------------------------------------------------------
+        //Getter/setter of I/O
+        int set_input(const size_t& instance, const size_t& id, const size_t& value);
+        int set_input_word(const size_t& word, const size_t& id, const uint64_t& bits);
+        size_t get_input(const size_t& instance, const size_t& id) const;
+        size_t get_output(const size_t& instance, const size_t& id) const;
+        uint64_t get_output_word(const size_t& word, const size_t& id) const;
+
+        //---------------------------------------------------------------------------------------
+        //Simulation of the instances
+        int set_current_state(const size_t& instance, const size_t& state_id);
+        int set_all_current_states(const size_t& state_id);
+        size_t get_current_state_id(const size_t& instance) const;
+        void step_all();
+        void step_all(const size_t& num_steps);
+};
+
+//Read only view of a compiled moore_fsm saved with moore_fsm::save_binary, memory mapped from the file.
+//Nothing is copied when the file is opened: the transition table, the outputs and the names are read in place,
+//so the pages of the file are shared between all the processes that open it.
+class mapped_moore_fsm {
+    private:
+        //Name table inside the file: the name of every id, then every name (aliases included) sorted for binary search
+        struct name_table_view {
+            const uint64_t* id_index;       //(offset, length) of the name of every id, length 0 if the id has no name
+            const uint64_t* sorted_index;   //(offset, length, id) of every name, sorted by name
+            const char* chars;
+            uint64_t num_ids;
+            uint64_t num_names;
+            uint64_t chars_size;
+
+            std::string_view get_name(const size_t& id) const;
+            size_t get_id(std::string_view name) const;
+            std::string_view get_sorted_name(const size_t& i) const;
+        };
+
+        const std::byte* data;
+        size_t data_size;
+
+        uint64_t num_inputs;
+        uint64_t num_outputs;
+        uint64_t num_states;
+        uint64_t num_encoded_inputs;
+        uint64_t initial_state_id;
+        const uint64_t* input_alphabet_sizes;
+        const uint64_t* state_outputs;
+        const uint64_t* transition_table;
+        name_table_view input_names;
+        name_table_view output_names;
+        name_table_view state_names;
+
+        static int parse_name_table(const std::byte* section, const size_t& section_size, const uint64_t& num_ids, name_table_view& view);
+
+    public:
+        //---------------------------------------------------------------------------------------
+        //Costructors and destructor
+        mapped_moore_fsm();
+        ~mapped_moore_fsm();
+        mapped_moore_fsm(const mapped_moore_fsm&) = delete;
+        mapped_moore_fsm& operator=(const mapped_moore_fsm&) = delete;
+        mapped_moore_fsm(mapped_moore_fsm&& other) noexcept;
+        mapped_moore_fsm& operator=(mapped_moore_fsm&& other) noexcept;
+
+        //---------------------------------------------------------------------------------------
+        //Opening and closing the file
+        int open(const std::string& path);
+        void close();
+        bool is_open() const {return data != nullptr;}
+
+        //---------------------------------------------------------------------------------------
+        //Getters of general machine info
+        size_t get_num_inputs() const {return num_inputs;}
+        size_t get_num_outputs() const {return num_outputs;}
+        size_t get_num_states() const {return num_states;}
+        size_t get_num_encoded_inputs() const {return num_encoded_inputs;}
+        size_t get_initial_state_id() const {return initial_state_id;}
+        size_t get_input_alphabet_size(const size_t& input_id) const;
+        size_t encode_inputs(std::span<const size_t> in) const;
+
+        //---------------------------------------------------------------------------------------
+        //Names
+        std::string_view get_input_name(const size_t& input_id) const {return input_names.get_name(input_id);}
+        size_t get_input_id(std::string_view name) const {return input_names.get_id(name);}
+        std::string_view get_output_name(const size_t& output_id) const {return output_names.get_name(output_id);}
+        size_t get_output_id(std::string_view name) const {return output_names.get_id(name);}
+        std::string_view get_state_name(const size_t& state_id) const {return state_names.get_name(state_id);}
+        size_t get_state_id(std::string_view name) const {return state_names.get_id(name);}
+
+        //---------------------------------------------------------------------------------------
+        //Transitions and outputs
+        size_t get_next_state(const size_t& state_id, const size_t& encoded_inputs) const;
+        std::span<const uint64_t> get_state_outputs(const size_t& state_id) const;
+        std::span<const uint64_t> get_transition_table() const {return {transition_table, num_states * num_encoded_inputs};}
+        moore_fsm to_moore_fsm() const;
+};
+
+//Thread pool that steps many independent machines, or runs many input traces through a shared machine, in parallel.
+//The work is split into one contiguous range per thread, and a thread that finishes its range steals chunks
+//from the ranges of the other threads. Every machine/trace is always processed by a single thread, so the results
+//don't depend on the scheduling.
+class fsm_executor {
+    private:
+        struct alignas(64) work_range {
+            std::atomic<size_t> next;
+            size_t end;
+        };
+
+        std::vector<std::thread> workers;
+        std::unique_ptr<work_range[]> ranges;   //One per thread, the calling thread included
+
+        std::mutex call_mutex;                  //Serializes calls to parallel_for
+        std::mutex job_mutex;
+        std::condition_variable job_cv;
+        std::condition_variable done_cv;
+        const std::function<void(size_t)>* job_fn;
+        size_t job_grain;
+        size_t job_generation;
+        size_t num_busy_workers;
+        bool stopping;
+        std::exception_ptr job_exception;
+
+        void worker_loop(const size_t& thread_id);
+        void work(const size_t& thread_id);
+
+    public:
+        //---------------------------------------------------------------------------------------
+        //Costructors and destructor
+        fsm_executor(const size_t& num_threads = 0);
+        ~fsm_executor();
+        fsm_executor(const fsm_executor&) = delete;
+        fsm_executor& operator=(const fsm_executor&) = delete;
+
+        //---------------------------------------------------------------------------------------
+        //Getters of general executor info
+        size_t get_num_threads() const {return workers.size() + 1;}
+
+        //---------------------------------------------------------------------------------------
+        //Parallel execution
+        void parallel_for(const size_t& count, const std::function<void(size_t)>& fn, const size_t& grain = 1);
+        void step_machines(std::span<moore_fsm> machines, const size_t& num_steps);
+        int run_machines(std::span<moore_fsm> machines, std::span<const std::span<const size_t>> input_traces);
+        int run_traces(const moore_fsm& fsm, std::span<const std::span<const size_t>> input_traces, std::span<size_t> final_states);
+};
+
+//Transition table of a machine known at compile time, for static_moore_fsm.
+//Inputs are encoded in mixed radix as in moore_fsm, so NumEncodedInputs must be the product of the alphabet sizes.
+//Invalid transitions are stored as -1.
+template<size_t NumStates, size_t NumEncodedInputs, size_t NumInputs, size_t NumOutputs>
+struct static_fsm_table {
+    std::array<size_t, NumInputs> input_alphabet_sizes;
+    std::array<std::array<size_t, NumOutputs>, NumStates> state_outputs;
+    std::array<std::array<size_t, NumEncodedInputs>, NumStates> next_state;
+
+    constexpr bool is_valid() const {
+        size_t num_encoded_inputs = 1;
+        for(const auto& alphabet_size : input_alphabet_sizes)
+            num_encoded_inputs *= alphabet_size;
+        if(num_encoded_inputs != NumEncodedInputs)
+            return false;
+
+        for(const auto& row : next_state)
+            for(const auto& next_state_id : row)
+                if(next_state_id >= NumStates && next_state_id != static_cast<size_t>(-1))
+                    return false;
+        return true;
+    }
+};
+
+//Builds a static_fsm_table at compile time probing transition_fn(state_id, inputs) and outputs_fn(state_id)
+//with every state and every combination of the inputs, like moore_fsm::compile does at run time
+template<size_t NumStates, size_t NumEncodedInputs, size_t NumInputs, size_t NumOutputs, typename transition_fn_t, typename outputs_fn_t>
+consteval static_fsm_table<NumStates, NumEncodedInputs, NumInputs, NumOutputs> make_static_fsm_table(const std::array<size_t, NumInputs>& input_alphabet_sizes, outputs_fn_t outputs_fn, transition_fn_t transition_fn){
+    static_fsm_table<NumStates, NumEncodedInputs, NumInputs, NumOutputs> table{};
+    table.input_alphabet_sizes = input_alphabet_sizes;
+
+    for(size_t s = 0; s < NumStates; ++s){
+        table.state_outputs[s] = outputs_fn(s);
+
+        std::array<size_t, NumInputs> probe{};
+        for(size_t e = 0; e < NumEncodedInputs; ++e){
+            const size_t next_state_id = transition_fn(s, probe);
+            table.next_state[s][e] = next_state_id < NumStates ? next_state_id : static_cast<size_t>(-1);
+
+            for(size_t i = 0; i < NumInputs; ++i){
+                if(++probe[i] < input_alphabet_sizes[i])
+                    break;
+                probe[i] = 0;
+            }
+        }
+    }
+
+    return table;
+}
+
+//Moore machine whose transition table is a compile time constant.
+//It has the same simulation interface as moore_fsm, but no std::function, no heap allocation and no std::vector:
+//stepping is a lookup into a constant table and the outputs are a reference into it.
+//Inputs outside of their alphabet make the transition invalid, since there is no transition function to fall back to.
+template<const auto& Table>
+class static_moore_fsm {
+    private:
+        using table_type = std::remove_cvref_t<decltype(Table)>;
+        static_assert(Table.is_valid(), "static_moore_fsm: invalid transition table");
+
+        static constexpr size_t num_inputs = std::tuple_size_v<decltype(table_type::input_alphabet_sizes)>;
+        static constexpr size_t num_states = std::tuple_size_v<decltype(table_type::next_state)>;
+        static constexpr size_t num_encoded_inputs = std::tuple_size_v<typename decltype(table_type::next_state)::value_type>;
+        static constexpr size_t num_outputs = std::tuple_size_v<typename decltype(table_type::state_outputs)::value_type>;
+
+        size_t current_state_id;
+        std::array<size_t, num_inputs> current_inputs;
+        size_t encoded_inputs;      //num_encoded_inputs if some input is outside of its alphabet
+
+        constexpr void encode_inputs(){
+            size_t encoded = 0;
+            size_t stride = 1;
+            for(size_t i = 0; i < num_inputs; ++i){
+                if(current_inputs[i] >= Table.input_alphabet_sizes[i]){
+                    encoded_inputs = num_encoded_inputs;
+                    return;
+                }
+                encoded += current_inputs[i] * stride;
+                stride *= Table.input_alphabet_sizes[i];
+            }
+            encoded_inputs = encoded;
+        }
+
+    public:
+        //---------------------------------------------------------------------------------------
+        //Costructors and destructor
+        constexpr static_moore_fsm(const size_t& initial_state_id = 0) :
+        current_state_id(initial_state_id < num_states ? initial_state_id : 0), current_inputs{}, encoded_inputs(0) {}
+
+        //---------------------------------------------------------------------------------------
+        //Getters of general machine info
+        static constexpr size_t get_num_inputs() {return num_inputs;}
+        static constexpr size_t get_num_outputs() {return num_outputs;}
+        static constexpr size_t get_num_states() {return num_states;}
+
+        //---------------------------------------------------------------------------------------
+        //Getter/setter of I/O
+        constexpr int set_input(const size_t& id, const size_t& value){
+            if(id >= num_inputs)
+                return 1;
+
+            current_inputs[id] = value;
+            encode_inputs();
+            return 0;
+        }
+        constexpr int set_inputs(const std::array<size_t, num_inputs>& in){
+            current_inputs = in;
+            encode_inputs();
+            return 0;
+        }
+        constexpr size_t get_output(const size_t& id) const {
+            if(id >= num_outputs)
+                return -1;
+
+            return Table.state_outputs[current_state_id][id];
+        }
+        constexpr const std::array<size_t, num_outputs>& get_outputs() const {return Table.state_outputs[current_state_id];}
+
+        //---------------------------------------------------------------------------------------
+        //Simulation of the machine
+        constexpr int set_current_state(const size_t& state_id){
+            if(state_id >= num_states)
+                return 1;
+
+            current_state_id = state_id;
+            return 0;
+        }
+        constexpr size_t get_current_state_id() const {return current_state_id;}
+        constexpr size_t step_machine(){
+            if(encoded_inputs >= num_encoded_inputs)
+                return -1;
+
+            const auto next_state_id = Table.next_state[current_state_id][encoded_inputs];
+            if(next_state_id >= num_states)
+                return -1;
+
+            current_state_id = next_state_id;
+            return current_state_id;
+        }
+        constexpr size_t step_machine(const size_t& num_steps){
+            size_t ret_val = 0;
+
+            for(size_t i = 0; i < num_steps; ++i)
+                ret_val = step_machine();
+
+            return ret_val;
+        }
 };
 
 #endif
\ No newline at end of file
@@ -1,26 +1,494 @@
 #include "fsmlib.hpp"
 #include <algorithm>
 #include <sstream>
+#include <deque>
+#include <charconv>
+#include <cstdio>
+#include <stdexcept>
 
 #include <iostream>
+#include <numeric>
+#include <map>
+#include <fstream>
+#include <cstring>
+#include <cerrno>
+#include <chrono>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    //Binary format of the tabulated machines, see moore_fsm::save_binary.
+    //Every field is a 64 bit unsigned integer in native byte order and every section is 8 byte aligned.
+    constexpr char binary_magic[8] = {'F', 'S', 'M', 'L', 'I', 'B', 'T', 'B'};
+    constexpr uint64_t binary_version = 1;
+
+    //Binary format of the dumps of transition_recorder: the header, then num_records records of record_size words, oldest first
+    constexpr char recorder_magic[8] = {'F', 'S', 'M', 'L', 'I', 'B', 'T', 'R'};
+    constexpr uint64_t recorder_version = 1;
+
+    struct recorder_header {
+        char magic[8];
+        uint64_t version;
+        uint64_t record_size;
+        uint64_t num_inputs;
+        uint64_t num_records;
+        uint64_t num_recorded;      //Records written in total, including the ones overwritten
+    };
+
+    //Binary format of the snapshots of the run state, see moore_fsm::save_snapshot and moore_fsm_bank::save_snapshot: the header, then
+    //for a moore_fsm the current state id and the inputs as 64 bit words, for a moore_fsm_bank the 32 bit current state ids
+    //and encoded inputs of all the instances, padded to 8 bytes. Only the run state is saved, never the definition or the names.
+    constexpr char snapshot_magic[8] = {'F', 'S', 'M', 'L', 'I', 'B', 'S', 'N'};
+    constexpr uint64_t snapshot_version = 1;
+    constexpr uint64_t snapshot_kind_machine = 0;
+    constexpr uint64_t snapshot_kind_bank = 1;
+
+    struct snapshot_header {
+        char magic[8];
+        uint64_t version;
+        uint64_t kind;
+        uint64_t num_instances;
+        uint64_t num_inputs;
+        uint64_t num_states;        //Snapshots are restored only into machines with the same number of states
+    };
+
+    snapshot_header make_snapshot_header(const uint64_t& kind, const size_t& num_instances, const size_t& num_inputs, const size_t& num_states){
+        snapshot_header header;
+        std::memcpy(header.magic, snapshot_magic, sizeof(header.magic));
+        header.version = snapshot_version;
+        header.kind = kind;
+        header.num_instances = num_instances;
+        header.num_inputs = num_inputs;
+        header.num_states = num_states;
+        return header;
+    }
+
+    bool check_snapshot_header(std::span<const std::byte> buffer, const snapshot_header& expected, const size_t& size){
+        if(buffer.size() != size)
+            return false;
+
+        snapshot_header header;
+        std::memcpy(&header, buffer.data(), sizeof(header));
+        return std::memcmp(header.magic, expected.magic, sizeof(header.magic)) == 0 && header.version == expected.version && header.kind == expected.kind &&
+               header.num_instances == expected.num_instances && header.num_inputs == expected.num_inputs && header.num_states == expected.num_states;
+    }
+
+    int write_snapshot_file(const std::string& path, std::span<const std::byte> buffer){
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if(!file)
+            return 2;
+
+        file.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+        return file ? 0 : 2;
+    }
+
+    int read_snapshot_file(const std::string& path, std::vector<std::byte>& buffer){
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if(!file)
+            return 3;
+
+        buffer.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(buffer.data()), buffer.size());
+        return file ? 0 : 3;
+    }
+
+    struct binary_header {
+        char magic[8];
+        uint64_t version;
+        uint64_t num_inputs;
+        uint64_t num_outputs;
+        uint64_t num_states;
+        uint64_t num_encoded_inputs;
+        uint64_t initial_state_id;
+        uint64_t alphabet_offset;
+        uint64_t outputs_offset;
+        uint64_t table_offset;
+        uint64_t input_names_offset;
+        uint64_t output_names_offset;
+        uint64_t state_names_offset;
+        uint64_t file_size;
+    };
+
+    //Name table section: num_ids, num_names, chars_size, then (offset, length) for every id,
+    //(offset, length, id) for every name sorted by name, and finally the characters
+    std::vector<uint64_t> make_name_table_section(const symbol_table& names, const size_t& num_ids, std::string& chars){
+        std::vector<std::pair<std::string_view, uint64_t>> sorted(names.begin(), names.end());
+        std::sort(sorted.begin(), sorted.end());
+
+        std::vector<uint64_t> section = {num_ids, sorted.size(), 0};
+        std::map<std::string_view, uint64_t> name_offset;
+        chars.clear();
+        for(const auto& [name, id] : sorted){
+            name_offset[name] = chars.size();
+            chars += name;
+        }
+        section[2] = chars.size();
+
+        for(size_t id = 0; id < num_ids; ++id){
+            const auto& name = names.get_name(id);
+            section.push_back(name.empty() ? 0 : name_offset.at(name));
+            section.push_back(name.size());
+        }
+        for(const auto& [name, id] : sorted){
+            section.push_back(name_offset.at(name));
+            section.push_back(name.size());
+            section.push_back(id);
+        }
+
+        return section;
+    }
+    //Schema driven JSON parser for the machine descriptions (see from_string).
+    //It walks the text once and hands strings out as views into it, without building a document tree.
+    class description_parser {
+        private:
+            std::string_view text;
+            size_t pos;
+            std::deque<std::string> unescaped_strings;     //Strings with escapes, which can't be views into the text
+
+            [[noreturn]] void fail(const std::string& what) const {
+                throw std::invalid_argument("from_string: " + what + " at offset " + std::to_string(pos));
+            }
+            void skip_whitespace(){
+                while(pos < text.size() && (text[pos] == ' ' || text[pos] == '\n' || text[pos] == '\r' || text[pos] == '\t'))
+                    ++pos;
+            }
+            bool consume(const char& c){
+                skip_whitespace();
+                if(pos < text.size() && text[pos] == c){
+                    ++pos;
+                    return true;
+                }
+                return false;
+            }
+            void expect(const char& c){
+                if(!consume(c))
+                    fail(std::string("expected '") + c + "'");
+            }
+
+        public:
+            description_parser(std::string_view str) : text(str), pos(0) {}
+
+            void expect_end(){
+                skip_whitespace();
+                if(pos != text.size())
+                    fail("unexpected characters");
+            }
+            std::string_view parse_string(){
+                expect('"');
+                const auto begin = pos;
+                while(pos < text.size() && text[pos] != '"' && text[pos] != '\\')
+                    ++pos;
+                if(pos < text.size() && text[pos] == '"')
+                    return text.substr(begin, pos++ - begin);
+
+                //Slow path for strings with escapes
+                std::string str(text.substr(begin, pos - begin));
+                while(pos < text.size() && text[pos] != '"'){
+                    if(text[pos] != '\\'){
+                        str += text[pos++];
+                        continue;
+                    }
+                    if(++pos >= text.size())
+                        break;
+                    switch(text[pos++]){
+                        case '"':  str += '"';  break;
+                        case '\\': str += '\\'; break;
+                        case '/':  str += '/';  break;
+                        case 'b':  str += '\b'; break;
+                        case 'f':  str += '\f'; break;
+                        case 'n':  str += '\n'; break;
+                        case 'r':  str += '\r'; break;
+                        case 't':  str += '\t'; break;
+                        case 'u': {
+                            unsigned code = 0;
+                            if(pos + 4 > text.size() || std::from_chars(text.data() + pos, text.data() + pos + 4, code, 16).ptr != text.data() + pos + 4 || code > 0x7f)
+                                fail("unsupported escape");
+                            str += static_cast<char>(code);
+                            pos += 4;
+                            break;
+                        }
+                        default:
+                            fail("invalid escape");
+                    }
+                }
+                if(pos >= text.size())
+                    fail("unterminated string");
+                ++pos;
+
+                unescaped_strings.push_back(std::move(str));
+                return unescaped_strings.back();
+            }
+            size_t parse_number(){
+                skip_whitespace();
+                size_t value = 0;
+                const auto [end, error] = std::from_chars(text.data() + pos, text.data() + text.size(), value);
+                if(error != std::errc())
+                    fail("expected an unsigned integer");
+                pos = end - text.data();
+                return value;
+            }
+            bool parse_null(){
+                skip_whitespace();
+                if(text.substr(pos, 4) == "null"){
+                    pos += 4;
+                    return true;
+                }
+                return false;
+            }
+            template<typename on_key_t>
+            void parse_object(on_key_t on_key){
+                expect('{');
+                if(consume('}'))
+                    return;
+                do {
+                    const auto key = parse_string();
+                    expect(':');
+                    on_key(key);
+                } while(consume(','));
+                expect('}');
+            }
+            template<typename on_element_t>
+            void parse_array(on_element_t on_element){
+                expect('[');
+                if(consume(']'))
+                    return;
+                do {
+                    on_element();
+                } while(consume(','));
+                expect(']');
+            }
+            void skip_value(){
+                skip_whitespace();
+                if(pos >= text.size())
+                    fail("unexpected end");
+
+                const auto c = text[pos];
+                if(c == '{')
+                    parse_object([&](std::string_view){skip_value();});
+                else if(c == '[')
+                    parse_array([&]{skip_value();});
+                else if(c == '"')
+                    parse_string();
+                else if(c == 't' || c == 'f' || c == 'n'){
+                    const std::string_view literal = c == 't' ? "true" : c == 'f' ? "false" : "null";
+                    if(text.substr(pos, literal.size()) != literal)
+                        fail("expected a value");
+                    pos += literal.size();
+                } else
+                    skip_number();
+            }
+            void skip_number(){
+                //Any JSON number: -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+                const auto skip_digits = [&]{
+                    const auto begin = pos;
+                    while(pos < text.size() && text[pos] >= '0' && text[pos] <= '9')
+                        ++pos;
+                    if(pos == begin)
+                        fail("expected a value");
+                };
+                if(pos < text.size() && text[pos] == '-')
+                    ++pos;
+                if(pos < text.size() && text[pos] == '0')
+                    ++pos;
+                else
+                    skip_digits();
+                if(pos < text.size() && text[pos] == '.'){
+                    ++pos;
+                    skip_digits();
+                }
+                if(pos < text.size() && (text[pos] == 'e' || text[pos] == 'E')){
+                    ++pos;
+                    if(pos < text.size() && (text[pos] == '+' || text[pos] == '-'))
+                        ++pos;
+                    skip_digits();
+                }
+            }
+    };
+
+    size_t name_table_section_size(const std::vector<uint64_t>& section, const std::string& chars){
+        return (section.size() * sizeof(uint64_t) + chars.size() + 7) / 8 * 8;
+    }
+
+    //Transition function of a state of a machine built from a transition table, rather than from user transition functions.
+    //It reads the same table used by the compiled machine, so that both paths give the same results.
+    handle_transition_fn make_tabulated_transition_fn(const std::shared_ptr<const std::vector<size_t>>& table, const std::shared_ptr<const std::vector<size_t>>& alphabet_sizes, const size_t& state_id){
+        return [table, alphabet_sizes, state_id](input_view inputs) -> size_t{
+            if(inputs.size() != alphabet_sizes->size())
+                return -1;
+
+            size_t encoded = 0;
+            size_t stride = 1;
+            for(size_t i = 0; i < inputs.size(); ++i){
+                if(inputs[i] >= (*alphabet_sizes)[i])
+                    return -1;
+                encoded += inputs[i] * stride;
+                stride *= (*alphabet_sizes)[i];
+            }
+
+            return (*table)[state_id * stride + encoded];
+        };
+    }
+
+    //Hash of the tuples of component states that are the states of a product machine, see moore_fsm::compose
+    struct state_tuple_hash {
+        size_t operator()(const std::vector<size_t>& tuple) const {
+            size_t h = tuple.size();
+            for(const auto& id : tuple)
+                h ^= std::hash<size_t>{}(id) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+            return h;
+        }
+    };
+
+    //Executor whose job the current thread is running, to detect nested calls to fsm_executor::parallel_for
+    thread_local const fsm_executor* running_executor = nullptr;
+
+    //Number of records decoded and stepped at a time by moore_fsm::run_stream
+    constexpr size_t stream_chunk_records = 16384;
+
+    //Reads the num_bits wide little endian field starting at bit bit_offset of data
+    size_t read_stream_field(const std::byte* data, const size_t& bit_offset, const size_t& num_bits){
+        size_t value = 0;
+        size_t read_bits = 0;
+        if(bit_offset % 8 == 0 && num_bits % 8 == 0){
+            //Byte aligned fields
+            for(size_t b = 0; b < num_bits / 8; ++b)
+                value |= static_cast<size_t>(data[bit_offset / 8 + b]) << (8 * b);
+            return value;
+        }
+
+        while(read_bits < num_bits){
+            const auto bit = bit_offset + read_bits;
+            const auto shift = bit % 8;
+            const auto taken = std::min(8 - shift, num_bits - read_bits);
+            const auto byte = static_cast<size_t>(data[bit / 8]) >> shift;
+            value |= (byte & ((size_t(1) << taken) - 1)) << read_bits;
+            read_bits += taken;
+        }
+        return value;
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+//symbol_table
+void symbol_table::reserve(const size_t& num_ids){
+    name_to_id.reserve(num_ids);
+    id_to_name.reserve(num_ids);
+}
+void symbol_table::clear(){
+    name_to_id.clear();
+    id_to_name.clear();
+}
+void symbol_table::set_name(const size_t& id, const std::string& name){
+    if(id >= id_to_name.size())
+        id_to_name.resize(id + 1);
+
+    //Drop the current name of the id
+    auto& old_name = id_to_name[id];
+    if(!old_name.empty()){
+        const auto it = name_to_id.find(old_name);
+        if(it != name_to_id.end() && it->second == id)
+            name_to_id.erase(it);
+    }
+
+    //The name is taken away from the id that had it before
+    const auto [it, inserted] = name_to_id.try_emplace(name, id);
+    if(!inserted){
+        if(it->second < id_to_name.size() && id_to_name[it->second] == name)
+            id_to_name[it->second].clear();
+        it->second = id;
+    }
+
+    id_to_name[id] = name;
+}
+void symbol_table::add_alias(const size_t& id, const std::string& name){
+    if(id >= id_to_name.size())
+        id_to_name.resize(id + 1);
+
+    const auto [it, inserted] = name_to_id.try_emplace(name, id);
+    if(!inserted){
+        if(it->second < id_to_name.size() && id_to_name[it->second] == name)
+            id_to_name[it->second].clear();
+        it->second = id;
+    }
+
+    //An id without a name gets the alias as its name
+    if(id_to_name[id].empty())
+        id_to_name[id] = name;
+}
+void symbol_table::remap(const std::vector<size_t>& old_to_new_id, const size_t& new_num_ids){
+    //Ids mapped outside of [0, new_num_ids) lose their names and aliases
+    std::vector<std::string> new_id_to_name(new_num_ids);
+    for(size_t id = 0; id < std::min(id_to_name.size(), old_to_new_id.size()); ++id)
+        if(old_to_new_id[id] < new_num_ids)
+            new_id_to_name[old_to_new_id[id]] = std::move(id_to_name[id]);
+
+    for(auto it = name_to_id.begin(); it != name_to_id.end();){
+        const auto new_id = it->second < old_to_new_id.size() ? old_to_new_id[it->second] : static_cast<size_t>(-1);
+        if(new_id >= new_num_ids)
+            it = name_to_id.erase(it);
+        else {
+            it->second = new_id;
+            ++it;
+        }
+    }
+
+    id_to_name = std::move(new_id_to_name);
+}
+bool symbol_table::contains(std::string_view name) const {
+    return name_to_id.find(name) != name_to_id.end();
+}
+size_t symbol_table::at(std::string_view name) const {
+    const auto it = name_to_id.find(name);
+    if(it == name_to_id.end())
+        throw std::out_of_range("symbol_table::at: unknown name");
+
+    return it->second;
+}
+size_t symbol_table::get_id(std::string_view name) const {
+    const auto it = name_to_id.find(name);
+    if(it == name_to_id.end())
+        return -1;
+
+    return it->second;
+}
+const std::string& symbol_table::get_name(const size_t& id) const {
+    static const std::string no_name;
+
+    if(id >= id_to_name.size())
+        return no_name;
+
+    return id_to_name[id];
+}
 
 //------------------------------------------------------------------------------------------------------------------------------------------
 //Constructor
 moore_fsm::moore_fsm(const size_t& _num_inputs, const size_t& _num_outputs, const size_t& _num_states) :
-num_inputs(_num_inputs), num_outputs(_num_outputs)
+num_inputs(_num_inputs), num_outputs(_num_outputs), num_encoded_inputs(0), compiled(false)
 {
     //Configure inputs and their names
     current_inputs = std::vector<size_t>(num_inputs, 0);
+    name_input_id_map.reserve(num_inputs);
     for(size_t i = 0; i < _num_inputs; ++i)
-        name_input_id_map[std::to_string(i)] = i;
+        name_input_id_map.set_name(i, std::to_string(i));
 
     //Configure outputs and their names
-    current_outputs = std::vector<size_t>(num_outputs, 0);
+    current_outputs_offset = 0;
+    output_arena = std::vector<size_t>(num_outputs, 0);
+    name_output_id_map.reserve(num_outputs);
     for(size_t i = 0; i < _num_outputs; ++i)
-        name_output_id_map[std::to_string(i)] = i;
+        name_output_id_map.set_name(i, std::to_string(i));
+
+    //No input alphabet is declared at the beginning
+    input_alphabet_sizes = std::vector<size_t>(num_inputs, 0);
+    input_strides = std::vector<size_t>(num_inputs, 0);
 
     //Pre allocate space for the states
     machine_states.reserve(_num_states);
+    name_state_id_map.reserve(_num_states);
+    output_arena.reserve((_num_states + 1) * num_outputs);
 
     current_state_id = 0;
 }
@@ -35,12 +503,13 @@ int moore_fsm::set_input(const size_t& id, const size_t& value){
     current_inputs[id] = value;
     return 0;
 }
-int moore_fsm::set_input(const std::string& name, const size_t& value){
-    if(name_input_id_map.contains(name)){
-        current_inputs[name_input_id_map.at(name)] = value;
-        return 0;
-    } else
+int moore_fsm::set_input(std::string_view name, const size_t& value){
+    const auto id = name_input_id_map.get_id(name);
+    if(id == static_cast<size_t>(-1))
         return 1;
+
+    current_inputs[id] = value;
+    return 0;
 }
 int moore_fsm::set_inputs(const std::vector<size_t>& in){
     if(in.size() < current_inputs.size()){
@@ -52,7 +521,7 @@ int moore_fsm::set_inputs(const std::vector<size_t>& in){
         return 2;
     }
     else {
-        current_inputs = in;
+        std::copy(in.begin(), in.end(), current_inputs.begin());
         return 0;
     }
 }
@@ -60,16 +529,28 @@ size_t moore_fsm::get_output(const size_t& id) const{
     if(id >= num_outputs)
         return -1;
 
-    return current_outputs[id];
+    return output_arena[current_outputs_offset + id];
 }
-size_t moore_fsm::get_output(const std::string& name) const{
-    if(name_output_id_map.contains(name))
-        return current_outputs[name_output_id_map.at(name)];
-    else
+size_t moore_fsm::get_output(std::string_view name) const{
+    const auto id = name_output_id_map.get_id(name);
+    if(id == static_cast<size_t>(-1))
         return -1;
+
+    return output_arena[current_outputs_offset + id];
+}
+int moore_fsm::set_inputs_packed(const uint64_t& bits){
+    if(num_inputs > 64)
+        return 1;
+
+    for(size_t i = 0; i < num_inputs; ++i)
+        current_inputs[i] = (bits >> i) & 1;
+    return 0;
 }
-const std::vector<size_t>& moore_fsm::get_outputs() const{
-    return current_outputs;
+uint64_t moore_fsm::get_outputs_packed() const {
+    uint64_t bits = 0;
+    for(size_t o = 0; o < std::min<size_t>(num_outputs, 64); ++o)
+        bits |= static_cast<uint64_t>(output_arena[current_outputs_offset + o] != 0) << o;
+    return bits;
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
@@ -78,22 +559,14 @@ int moore_fsm::set_input_name(const size_t& input_id, const std::string& name){
     if(input_id >= num_inputs)
         return 1;
 
-    std::erase_if(name_input_id_map, [&](const auto& e) -> bool{return e.second == input_id;});
-    name_input_id_map[name] = input_id;
+    name_input_id_map.set_name(input_id, name);
     return 0;
 }
 std::string moore_fsm::get_input_name(const size_t& input_id) const {
-    const auto it = std::find_if(name_input_id_map.begin(), name_input_id_map.end(), [&](const auto& e) -> bool{return e.second == input_id;});
-    if(it != std::end(name_input_id_map))
-        return it->first;
-    else
-        return "";
+    return name_input_id_map.get_name(input_id);
 }
-size_t moore_fsm::get_input_id(const std::string& name) const {
-    if(name_input_id_map.contains(name))
-        return name_input_id_map.at(name);
-    else
-        return -1;
+size_t moore_fsm::get_input_id(std::string_view name) const {
+    return name_input_id_map.get_id(name);
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
@@ -102,28 +575,21 @@ int moore_fsm::set_output_name(const size_t& output_id, const std::string& name)
     if(output_id >= num_outputs)
         return 1;
 
-    std::erase_if(name_output_id_map, [&](const auto& e) -> bool{return e.second == output_id;});
-    name_output_id_map[name] = output_id;
+    name_output_id_map.set_name(output_id, name);
     return 0;
 }
-std::string moore_fsm::get_output_name(const size_t& output_id){
-    const auto it = std::find_if(name_output_id_map.begin(), name_output_id_map.end(), [&](const auto& e) -> bool{return e.second == output_id;});
-    if(it != std::end(name_output_id_map))
-        return it->first;
-    else
-        return "";
+std::string moore_fsm::get_output_name(const size_t& output_id) const {
+    return name_output_id_map.get_name(output_id);
 }
-size_t moore_fsm::get_output_id(const std::string& name){
-    if(name_output_id_map.contains(name))
-        return name_output_id_map.at(name);
-    else
-        return -1;
+size_t moore_fsm::get_output_id(std::string_view name) const {
+    return name_output_id_map.get_id(name);
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
 //Adding and removing states
 size_t moore_fsm::add_state(const std::vector<size_t>& outputs, const state_transition_fn& transition_fn){
-    machine_states.emplace_back(outputs, transition_fn);
+    machine_states.emplace_back(transition_fn);
+    set_state_outputs(machine_states.size() - 1, outputs);
 
     const auto last_state_id = machine_states.size() - 1;
     set_state_name(last_state_id, std::to_string(last_state_id));
@@ -131,7 +597,60 @@ size_t moore_fsm::add_state(const std::vector<size_t>& outputs, const state_tran
     return last_state_id;
 }
 size_t moore_fsm::add_state(const std::string& name, const std::vector<size_t>& outputs, const state_transition_fn& transition_fn){
-    machine_states.emplace_back(outputs, transition_fn);
+    //The state may have been declared before, to be referenced by the states added before it
+    const auto state_id = name.empty() ? static_cast<size_t>(-1) : name_state_id_map.get_id(name);
+    if(state_id < machine_states.size() && !machine_states[state_id].transition_fn && !machine_states[state_id].handle_fn){
+        define_state(state_id, outputs, transition_fn);
+        return state_id;
+    }
+
+    machine_states.emplace_back(transition_fn);
+    set_state_outputs(machine_states.size() - 1, outputs);
+
+    const auto last_state_id = machine_states.size() - 1;
+    if(name.empty())
+        set_state_name(last_state_id, std::to_string(last_state_id));
+    else
+        set_state_name(last_state_id, name);
+
+    return last_state_id;
+}
+size_t moore_fsm::add_state(const std::vector<size_t>& outputs, const handle_transition_fn& transition_fn){
+    machine_states.emplace_back(transition_fn);
+    set_state_outputs(machine_states.size() - 1, outputs);
+
+    const auto last_state_id = machine_states.size() - 1;
+    set_state_name(last_state_id, std::to_string(last_state_id));
+
+    return last_state_id;
+}
+size_t moore_fsm::add_state(const std::string& name, const std::vector<size_t>& outputs, const handle_transition_fn& transition_fn){
+    //The state may have been declared before, to be referenced by the states added before it
+    const auto state_id = name.empty() ? static_cast<size_t>(-1) : name_state_id_map.get_id(name);
+    if(state_id < machine_states.size() && !machine_states[state_id].transition_fn && !machine_states[state_id].handle_fn){
+        define_state(state_id, outputs, transition_fn);
+        return state_id;
+    }
+
+    machine_states.emplace_back(transition_fn);
+    set_state_outputs(machine_states.size() - 1, outputs);
+
+    const auto last_state_id = machine_states.size() - 1;
+    if(name.empty())
+        set_state_name(last_state_id, std::to_string(last_state_id));
+    else
+        set_state_name(last_state_id, name);
+
+    return last_state_id;
+}
+size_t moore_fsm::declare_state(const std::string& name){
+    const auto state_id = name_state_id_map.get_id(name);
+    if(state_id < machine_states.size())
+        return state_id;
+
+    //Placeholder without a transition function: stepping from it fails until it is defined
+    machine_states.emplace_back(state_transition_fn());
+    set_state_outputs(machine_states.size() - 1, {});
 
     const auto last_state_id = machine_states.size() - 1;
     if(name.empty())
@@ -141,27 +660,81 @@ size_t moore_fsm::add_state(const std::string& name, const std::vector<size_t>&
 
     return last_state_id;
 }
-/*
-This code doesn't re-map the names to the states. It's a feature that has to be added.
-int moore_fsm::remove_state(const size_t& state_id){
+int moore_fsm::define_state(const size_t& state_id, const std::vector<size_t>& outputs, const handle_transition_fn& transition_fn){
     if(state_id >= machine_states.size())
         return 1;
 
-    machine_states.erase(machine_states.begin() + state_id);
-    std::erase_if(name_state_id_map, [&](const auto& e) -> bool{return e.second == state_id;});
+    machine_states[state_id] = state(transition_fn);
+    set_state_outputs(state_id, outputs);
+    compiled = false;
+    return 0;
+}
+int moore_fsm::define_state(const size_t& state_id, const std::vector<size_t>& outputs, const state_transition_fn& transition_fn){
+    if(state_id >= machine_states.size())
+        return 1;
 
+    machine_states[state_id] = state(transition_fn);
+    set_state_outputs(state_id, outputs);
+    compiled = false;
     return 0;
 }
-int moore_fsm::remove_state(const std::string& name){
-    if(!name_state_id_map.contains(name))
+int moore_fsm::add_states(const std::vector<std::string>& names, const std::vector<std::vector<size_t>>& outputs, const std::vector<state_transition_fn>& transition_fns, std::vector<size_t>& state_ids){
+    if(outputs.size() != names.size() || transition_fns.size() != names.size())
         return 1;
-    else {
-        const auto id = name_state_id_map.at(name);
 
-        return remove_state(id);
-    }
+    //Growing the containers once, every add_state is then a plain append
+    machine_states.reserve(machine_states.size() + names.size());
+    output_arena.reserve(output_arena.size() + names.size() * num_outputs);
+    name_state_id_map.reserve(machine_states.size() + names.size());
+
+    state_ids.resize(names.size());
+    for(size_t i = 0; i < names.size(); ++i)
+        state_ids[i] = add_state(names[i], outputs[i], transition_fns[i]);
+
+    return 0;
+}
+int moore_fsm::add_states(const std::vector<std::string>& names, const std::vector<std::vector<size_t>>& outputs, const std::vector<handle_transition_fn>& transition_fns, std::vector<size_t>& state_ids){
+    if(outputs.size() != names.size() || transition_fns.size() != names.size())
+        return 1;
+
+    //Growing the containers once, every add_state is then a plain append
+    machine_states.reserve(machine_states.size() + names.size());
+    output_arena.reserve(output_arena.size() + names.size() * num_outputs);
+    name_state_id_map.reserve(machine_states.size() + names.size());
+
+    state_ids.resize(names.size());
+    for(size_t i = 0; i < names.size(); ++i)
+        state_ids[i] = add_state(names[i], outputs[i], transition_fns[i]);
+
+    return 0;
+}
+int moore_fsm::remove_state(const size_t& state_id, std::vector<size_t>& old_to_new_state_id){
+    return remove_states(std::span<const size_t>(&state_id, 1), old_to_new_state_id);
+}
+int moore_fsm::remove_state(std::string_view name, std::vector<size_t>& old_to_new_state_id){
+    const auto id = name_state_id_map.get_id(name);
+    if(id >= machine_states.size())
+        return 1;
+
+    return remove_state(id, old_to_new_state_id);
+}
+int moore_fsm::remove_states(std::span<const size_t> state_ids, std::vector<size_t>& old_to_new_state_id){
+    const auto num_states = machine_states.size();
+    if(std::any_of(state_ids.begin(), state_ids.end(), [&](const size_t& id){return id >= num_states;}))
+        return 1;
+
+    //The remaining states are compacted keeping their relative order, the removed ones are mapped to -1
+    old_to_new_state_id.assign(num_states, 0);
+    for(const auto& id : state_ids)
+        old_to_new_state_id[id] = -1;
+
+    size_t new_num_states = 0;
+    for(auto& new_id : old_to_new_state_id)
+        new_id = new_id == 0 ? new_num_states++ : static_cast<size_t>(-1);
+
+    remap_states(old_to_new_state_id, new_num_states);
+    return 0;
 }
-*/
 
 //------------------------------------------------------------------------------------------------------------------------------------------
 //Associating names to states
@@ -169,22 +742,31 @@ int moore_fsm::set_state_name(const size_t& state_id, const std::string& name){
     if(state_id >= machine_states.size())
     return 1;
 
-    std::erase_if(name_state_id_map, [&](const auto& e) -> bool{return e.second == state_id;});
-    name_state_id_map[name] = state_id;
+    name_state_id_map.set_name(state_id, name);
     return 0;
 }
-std::string moore_fsm::get_state_name(const size_t& state_id){
-    const auto it = std::find_if(name_state_id_map.begin(), name_state_id_map.end(), [&](const auto& e) -> bool{return e.second == state_id;});
-    if(it != std::end(name_state_id_map))
-        return it->first;
-    else
-        return "";
+std::string moore_fsm::get_state_name(const size_t& state_id) const {
+    return name_state_id_map.get_name(state_id);
 }
-size_t moore_fsm::get_state_id(const std::string& name){
-    if(name_state_id_map.contains(name))
-        return name_state_id_map.at(name);
-    else
-        return -1;
+size_t moore_fsm::get_state_id(std::string_view name) const {
+    return name_state_id_map.get_id(name);
+}
+
+std::span<const size_t> moore_fsm::get_state_outputs(const size_t& state_id) const {
+    if(state_id >= machine_states.size())
+        return {};
+
+    return std::span<const size_t>(output_arena).subspan((state_id + 1) * num_outputs, num_outputs);
+}
+void moore_fsm::set_state_outputs(const size_t& state_id, const std::vector<size_t>& outputs){
+    //Outputs missing from the vector are 0, extra ones are ignored
+    const auto offset = (state_id + 1) * num_outputs;
+    if(output_arena.size() < offset + num_outputs)
+        output_arena.resize(offset + num_outputs, 0);
+
+    const auto num_copied = std::min(num_outputs, outputs.size());
+    std::copy_n(outputs.begin(), num_copied, output_arena.begin() + offset);
+    std::fill(output_arena.begin() + offset + num_copied, output_arena.begin() + offset + num_outputs, 0);
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
@@ -194,36 +776,112 @@ int moore_fsm::set_current_state(const size_t& state_id){
         return 1;
 
     current_state_id = state_id;
-    current_outputs = machine_states[current_state_id].state_outputs;
+    current_outputs_offset = (current_state_id + 1) * num_outputs;
     return 0;
 }
-int moore_fsm::set_current_state(const std::string& name){
-    if(!name_state_id_map.contains(name))
+int moore_fsm::set_current_state(std::string_view name){
+    const auto id = name_state_id_map.get_id(name);
+    if(id == static_cast<size_t>(-1))
         return 1;
-    else {
-        const auto id = name_state_id_map.at(name);
 
-        return set_current_state(id);
-    }
+    return set_current_state(id);
 }
 size_t moore_fsm::get_current_state_id() const {
     return current_state_id;
 }
 std::string moore_fsm::get_current_state_name() const {
-    const auto it = std::find_if(name_state_id_map.begin(), name_state_id_map.end(), [&](const auto& e) -> bool{return e.second == current_state_id;});
-    if(it != std::end(name_state_id_map))
-        return it->first;
+    return name_state_id_map.get_name(current_state_id);
+}
+size_t moore_fsm::call_transition_fn(const size_t& state_id, const std::vector<size_t>& inputs) const {
+    const auto& s = machine_states[state_id];
+
+    //Declared states that haven't been defined yet have no transition function
+    if(s.handle_fn){
+        const auto next_state_id = s.handle_fn(input_view(inputs));
+        return s.id_space ? translate_state_id(*s.id_space, next_state_id) : next_state_id;
+    } else if(s.transition_fn){
+        //A name looked up with at() and missing from the live table, like the name of a removed state, makes the transition invalid
+        try {
+            return s.transition_fn(inputs, name_input_id_map, name_state_id_map);
+        } catch(const std::out_of_range&) {
+            return -1;
+        }
+    } else
+        return -1;
+}
+size_t moore_fsm::get_next_state(const size_t& state_id, const std::vector<size_t>& inputs) const {
+    if(state_id >= machine_states.size())
+        return -1;
+
+    size_t encoded_inputs = -1;
+
+    //Use the transition table when the machine is compiled and the inputs are inside the declared alphabet,
+    //otherwise fall back to the transition function of the state
+    if(compiled)
+        encoded_inputs = encode_inputs(inputs);
+    if(encoded_inputs != static_cast<size_t>(-1))
+        return (*transition_table)[state_id * num_encoded_inputs + encoded_inputs];
     else
-        return "";
+        return call_transition_fn(state_id, inputs);
+}
+size_t moore_fsm::get_next_state(const size_t& state_id, std::span<const size_t> inputs, std::vector<size_t>& scratch_inputs) const {
+    if(state_id >= machine_states.size())
+        return -1;
+
+    //The inputs are copied into the scratch vector only when the transition function has to be called
+    const size_t encoded_inputs = compiled ? encode_inputs(inputs) : -1;
+    if(encoded_inputs != static_cast<size_t>(-1))
+        return (*transition_table)[state_id * num_encoded_inputs + encoded_inputs];
+
+    //Handle based transition functions read the inputs in place
+    const auto& s = machine_states[state_id];
+    if(s.handle_fn){
+        const auto next_state_id = s.handle_fn(input_view(inputs));
+        return s.id_space ? translate_state_id(*s.id_space, next_state_id) : next_state_id;
+    }
+
+    scratch_inputs.assign(inputs.begin(), inputs.end());
+    return call_transition_fn(state_id, scratch_inputs);
+}
+size_t moore_fsm::get_profiled_next_state(){
+    size_t next_state_id;
+    if(--profiler.countdown != 0)
+        next_state_id = get_next_state(current_state_id, current_inputs);
+    else {
+        //Sampled step: only the calls of the transition functions are timed, not the lookups in the table
+        profiler.countdown = profiler.ptr->get_sampling_period();
+        const bool calls_fn = !compiled || encode_inputs(current_inputs) == static_cast<size_t>(-1);
+        uint64_t nanoseconds = 0;
+        if(calls_fn){
+            const auto start = std::chrono::steady_clock::now();
+            next_state_id = get_next_state(current_state_id, current_inputs);
+            nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        } else
+            next_state_id = get_next_state(current_state_id, current_inputs);
+
+        profiler.ptr->count_sample(*profiler.counters, current_state_id, next_state_id < machine_states.size() ? next_state_id : -1, calls_fn, nanoseconds);
+    }
+
+    if(next_state_id < machine_states.size())
+        profiler.ptr->count_visit(*profiler.counters, next_state_id);
+    return next_state_id;
+}
+void moore_fsm::attach_profiler(transition_profiler& prof){
+    profiler.ptr = &prof;
+    profiler.counters = prof.add_shard(profiler.counters);
+    profiler.countdown = prof.get_sampling_period();
 }
 size_t moore_fsm::step_machine(){
-    const auto next_state_id = machine_states[current_state_id].transition_fn(current_inputs, name_input_id_map, name_state_id_map);
+    const auto next_state_id = profiler.ptr == nullptr ? get_next_state(current_state_id, current_inputs) : get_profiled_next_state();
+
+    if(recorder.ptr != nullptr)
+        recorder.ptr->record(current_state_id, next_state_id < machine_states.size() ? next_state_id : -1, current_inputs);
 
     if(next_state_id >= machine_states.size())
         return -1;
 
     current_state_id = next_state_id;
-    current_outputs = machine_states[current_state_id].state_outputs;
+    current_outputs_offset = (current_state_id + 1) * num_outputs;
 
     return current_state_id;
 }
@@ -235,43 +893,2944 @@ size_t moore_fsm::step_machine(const size_t& num_steps){
 
     return ret_val;
 }
+size_t moore_fsm::step_machine(const size_t& num_steps, size_t& num_elided_steps){
+    size_t ret_val = 0;
+    num_elided_steps = 0;
 
-//------------------------------------------------------------------------------------------------------------------------------------------
-//Saving/loading the machine
-/*
-std::string to_string(const moore_fsm& mfsm){
-    std::stringstream ret;
-    ret << "{";
-
-    //Load the number of inputs, outputs and states
-    ret << "\"" << "num_inputs" << "\":" << mfsm.num_inputs << ",";
-    ret << "\"" << "num_outputs" << "\":" << mfsm.num_outputs << ",";
-    ret << "\"" << "num_states" << "\":" << mfsm.machine_states.size() << ",";
-
-    //Load the aliases of the inputs
-    ret << "\"input_names\":[";
-    for(auto it = mfsm.name_input_id_map.begin(); it != mfsm.name_input_id_map.end(); ++it)
-        ret << "\"" << it->first << "\",\"" << it->second << "\"" << ",";
-    ret.seekp(-1, ret.cur);
-    ret << "],";
-
-    //Load the aliases of the outputs
-    ret << "\"output_names\":[";
-    for(auto it = mfsm.name_output_id_map.begin(); it != mfsm.name_output_id_map.end(); ++it)
-        ret << "\"" << it->first << "\",\"" << it->second << "\"" << ",";
-    ret.seekp(-1, ret.cur);
-    ret << "],";
-
-    //Load the aliases of the states
-    ret << "\"state_names\":[";
-    for(auto it = mfsm.name_state_id_map.begin(); it != mfsm.name_state_id_map.end(); ++it)
-        ret << "\"" << it->first << "\",\"" << it->second << "\"" << ",";
-    ret.seekp(-1, ret.cur);
-    ret << "]";
-
-    //how do I serialize std::function-s?
-
-    ret << "}";
-    return ret.str();
-}
-*/
\ No newline at end of file
+    //With the inputs fixed, a self-loop or an invalid transition repeats identically at every following step.
+    //The recorder and the profiler have to see every step, so nothing is elided while one of them is attached.
+    const bool elide = recorder.ptr == nullptr && profiler.ptr == nullptr;
+    for(size_t i = 0; i < num_steps; ++i){
+        const auto state_id = current_state_id;
+        ret_val = step_machine();
+        if(elide && (ret_val == state_id || ret_val == static_cast<size_t>(-1))){
+            num_elided_steps = num_steps - i - 1;
+            break;
+        }
+    }
+
+    return ret_val;
+}
+size_t moore_fsm::step_machine_packed(const uint64_t& bits){
+    if(set_inputs_packed(bits) != 0)
+        return -1;
+    if(!compiled || !is_boolean() || current_state_id >= machine_states.size() || profiler.ptr != nullptr)
+        return step_machine();
+
+    //With every alphabet of size 2, the mixed radix encoding of the inputs is the packed bits themselves
+    const auto next_state_id = (*transition_table)[current_state_id * num_encoded_inputs + (bits & (num_encoded_inputs - 1))];
+
+    if(recorder.ptr != nullptr)
+        recorder.ptr->record(current_state_id, next_state_id < machine_states.size() ? next_state_id : -1, current_inputs);
+
+    if(next_state_id >= machine_states.size())
+        return -1;
+
+    current_state_id = next_state_id;
+    current_outputs_offset = (current_state_id + 1) * num_outputs;
+    return current_state_id;
+}
+
+size_t moore_fsm::get_trace_steps(std::span<const size_t> input_trace, std::span<const size_t> output_trace, const trace_mode& mode) const {
+    if(num_inputs == 0 || input_trace.size() % num_inputs != 0 || machine_states.empty())
+        return -1;
+
+    const auto num_steps = input_trace.size() / num_inputs;
+    if(mode == trace_mode::states && output_trace.size() < num_steps)
+        return -1;
+    if(mode == trace_mode::outputs && output_trace.size() < num_steps * num_outputs)
+        return -1;
+
+    return num_steps;
+}
+size_t moore_fsm::run_trace(size_t& state_id, std::span<const size_t> input_trace, std::span<size_t> output_trace, const trace_mode& mode, std::vector<size_t>& scratch_inputs) const {
+    const auto num_steps = input_trace.size() / num_inputs;
+
+    size_t ret_val = state_id;
+    for(size_t k = 0; k < num_steps; ++k){
+        //When compiled, the inputs are encoded straight from the trace, without copying them into the scratch vector
+        const auto next_state_id = get_next_state(state_id, input_trace.subspan(k * num_inputs, num_inputs), scratch_inputs);
+
+        //Same behaviour as step_machine: an invalid next state leaves the machine where it is
+        if(next_state_id < machine_states.size()){
+            state_id = next_state_id;
+            ret_val = state_id;
+        } else
+            ret_val = -1;
+
+        if(mode == trace_mode::states)
+            output_trace[k] = ret_val;
+        else if(mode == trace_mode::outputs){
+            const auto state_outputs = output_arena.begin() + (state_id + 1) * num_outputs;
+            std::copy_n(state_outputs, num_outputs, output_trace.begin() + k * num_outputs);
+        }
+    }
+
+    return ret_val;
+}
+size_t moore_fsm::run_trace_events(size_t& state_id, std::span<const size_t> input_trace, std::span<size_t> output_trace, const trace_mode& mode, std::vector<size_t>& scratch_inputs, size_t& num_elided_steps) const {
+    const auto num_steps = input_trace.size() / num_inputs;
+
+    size_t ret_val = state_id;
+    num_elided_steps = 0;
+    for(size_t k = 0; k < num_steps;){
+        const auto next_state_id = get_next_state(state_id, input_trace.subspan(k * num_inputs, num_inputs), scratch_inputs);
+        const bool stable = next_state_id == state_id || next_state_id >= machine_states.size();
+        if(next_state_id < machine_states.size()){
+            state_id = next_state_id;
+            ret_val = state_id;
+        } else
+            ret_val = -1;
+
+        //From a self-loop or an invalid transition, the machine doesn't move until the inputs change
+        auto end = k + 1;
+        if(stable){
+            const auto inputs = input_trace.subspan(k * num_inputs, num_inputs);
+            while(end < num_steps && std::equal(inputs.begin(), inputs.end(), input_trace.begin() + end * num_inputs))
+                ++end;
+            num_elided_steps += end - k - 1;
+        }
+
+        if(mode == trace_mode::states)
+            std::fill(output_trace.begin() + k, output_trace.begin() + end, ret_val);
+        else if(mode == trace_mode::outputs){
+            const auto state_outputs = output_arena.begin() + (state_id + 1) * num_outputs;
+            for(; k < end; ++k)
+                std::copy_n(state_outputs, num_outputs, output_trace.begin() + k * num_outputs);
+        }
+        k = end;
+    }
+
+    return ret_val;
+}
+size_t moore_fsm::run(std::span<const size_t> input_trace, std::span<size_t> output_trace, const trace_mode& mode){
+    const auto num_steps = get_trace_steps(input_trace, output_trace, mode);
+    if(num_steps == static_cast<size_t>(-1))
+        return -1;
+
+    const auto ret_val = run_trace(current_state_id, input_trace, output_trace, mode, current_inputs);
+
+    //The current inputs and outputs are updated only once, at the end of the trace
+    if(num_steps != 0){
+        const auto last_inputs = input_trace.last(num_inputs);
+        std::copy(last_inputs.begin(), last_inputs.end(), current_inputs.begin());
+        current_outputs_offset = (current_state_id + 1) * num_outputs;
+    }
+
+    return ret_val;
+}
+size_t moore_fsm::run_events(std::span<const size_t> input_trace, std::span<size_t> output_trace, const trace_mode& mode, size_t& num_elided_steps){
+    num_elided_steps = 0;
+    const auto num_steps = get_trace_steps(input_trace, output_trace, mode);
+    if(num_steps == static_cast<size_t>(-1))
+        return -1;
+
+    const auto ret_val = run_trace_events(current_state_id, input_trace, output_trace, mode, current_inputs, num_elided_steps);
+
+    if(num_steps != 0){
+        const auto last_inputs = input_trace.last(num_inputs);
+        std::copy(last_inputs.begin(), last_inputs.end(), current_inputs.begin());
+        current_outputs_offset = (current_state_id + 1) * num_outputs;
+    }
+
+    return ret_val;
+}
+size_t moore_fsm::run_parallel(fsm_executor& executor, std::span<const size_t> input_trace, std::span<size_t> output_trace, const trace_mode& mode){
+    const auto num_steps = get_trace_steps(input_trace, output_trace, mode);
+    if(num_steps == static_cast<size_t>(-1))
+        return -1;
+    if(!compiled && compile() != 0)
+        return -1;
+
+    //Short traces aren't worth splitting. Without a current state every step is invalid, and the chunks have no start state to compose
+    constexpr size_t min_chunk_steps = 4096;
+    const auto num_chunks = std::min(executor.get_num_threads() * 4, num_steps / min_chunk_steps);
+    if(num_chunks < 2 || current_state_id >= machine_states.size())
+        return run(input_trace, output_trace, mode);
+
+    const auto num_states = machine_states.size();
+    const auto chunk_begin = [&](const size_t& c) -> size_t {return num_steps * c / num_chunks;};
+    const auto chunk_inputs = [&](const size_t& c){
+        return input_trace.subspan(chunk_begin(c) * num_inputs, (chunk_begin(c + 1) - chunk_begin(c)) * num_inputs);
+    };
+
+    //Phase 1: the end state of the first chunk is computed directly, while for every other chunk
+    //the state reached from every possible start state is computed (the transfer function of the chunk).
+    //The machines are simulated from all the states at once, merging the ones that converge to the same state.
+    std::vector<size_t> chunk_end_state(num_chunks);
+    std::vector<std::vector<size_t>> transfer(num_chunks);
+    executor.parallel_for(num_chunks, [&](const size_t& c){
+        std::vector<size_t> scratch_inputs;
+        const auto inputs = chunk_inputs(c);
+        const auto chunk_steps = inputs.size() / num_inputs;
+
+        if(c == 0){
+            size_t state_id = current_state_id;
+            run_trace(state_id, inputs, {}, trace_mode::final_state, scratch_inputs);
+            chunk_end_state[0] = state_id;
+            return;
+        }
+
+        std::vector<size_t> active(num_states);                 //Distinct states still being simulated
+        std::vector<size_t> start_to_active(num_states);        //Index in active of the state reached from each start state
+        std::vector<size_t> merged_index(num_states, -1);
+        for(size_t s = 0; s < num_states; ++s)
+            active[s] = start_to_active[s] = s;
+
+        constexpr size_t merge_period = 16;
+        for(size_t k = 0; k < chunk_steps; ++k){
+            const auto step_inputs = inputs.subspan(k * num_inputs, num_inputs);
+            const auto encoded_inputs = encode_inputs(step_inputs);
+
+            for(auto& state_id : active){
+                const auto next_state_id = encoded_inputs != static_cast<size_t>(-1) ?
+                                           (*transition_table)[state_id * num_encoded_inputs + encoded_inputs] :
+                                           get_next_state(state_id, step_inputs, scratch_inputs);
+                if(next_state_id < num_states)
+                    state_id = next_state_id;
+            }
+
+            //Merge the active states that converged
+            if(active.size() > 1 && (k % merge_period == merge_period - 1 || k == chunk_steps - 1)){
+                std::vector<size_t> merged;
+                std::vector<size_t> active_to_merged(active.size());
+                for(size_t a = 0; a < active.size(); ++a){
+                    if(merged_index[active[a]] == static_cast<size_t>(-1)){
+                        merged_index[active[a]] = merged.size();
+                        merged.push_back(active[a]);
+                    }
+                    active_to_merged[a] = merged_index[active[a]];
+                }
+                for(auto& a : start_to_active)
+                    a = active_to_merged[a];
+                for(const auto& state_id : merged)
+                    merged_index[state_id] = -1;
+                active = std::move(merged);
+            }
+        }
+
+        transfer[c].resize(num_states);
+        for(size_t s = 0; s < num_states; ++s)
+            transfer[c][s] = active[start_to_active[s]];
+    });
+
+    //Phase 2: compose the transfer functions to find the start state of every chunk
+    std::vector<size_t> chunk_start_state(num_chunks);
+    chunk_start_state[0] = current_state_id;
+    for(size_t c = 1; c < num_chunks; ++c)
+        chunk_start_state[c] = c == 1 ? chunk_end_state[0] : transfer[c - 1][chunk_start_state[c - 1]];
+
+    //Phase 3: run every chunk again from its real start state to write the trace.
+    //When only the final state is kept, the last chunk is run anyway to know if its last transition was valid.
+    size_t ret_val = -1;
+    size_t final_state_id = 0;
+    const auto first_chunk = mode == trace_mode::final_state ? num_chunks - 1 : 0;
+    executor.parallel_for(num_chunks - first_chunk, [&](const size_t& i){
+        std::vector<size_t> scratch_inputs;
+        const auto c = first_chunk + i;
+        const auto trace_offset = mode == trace_mode::outputs ? chunk_begin(c) * num_outputs : chunk_begin(c);
+        size_t state_id = chunk_start_state[c];
+
+        const auto chunk_ret_val = run_trace(state_id, chunk_inputs(c), mode == trace_mode::final_state ? output_trace : output_trace.subspan(trace_offset), mode, scratch_inputs);
+        if(c == num_chunks - 1){
+            ret_val = chunk_ret_val;
+            final_state_id = state_id;
+        }
+    });
+
+    //The current inputs and outputs are updated only once, at the end of the trace
+    current_state_id = final_state_id;
+    const auto last_inputs = input_trace.last(num_inputs);
+    std::copy(last_inputs.begin(), last_inputs.end(), current_inputs.begin());
+    current_outputs_offset = (current_state_id + 1) * num_outputs;
+
+    return ret_val;
+}
+int moore_fsm::run_stream_records(std::span<const std::byte> data, const size_t& num_records, const stream_format& format, const trace_mode& mode, const stream_sink_fn& sink,
+                                  std::vector<size_t>& input_trace, std::vector<size_t>& results){
+    const auto record_bits = format.record_bits == 0 ? num_inputs * format.field_bits : format.record_bits;
+
+    //The buffers have room for a whole chunk, so they are allocated only once per run
+    for(size_t r = 0; r < num_records; ++r)
+        for(size_t i = 0; i < num_inputs; ++i)
+            input_trace[r * num_inputs + i] = read_stream_field(data.data(), r * record_bits + i * format.field_bits, format.field_bits);
+
+    const auto inputs = std::span<const size_t>(input_trace).first(num_records * num_inputs);
+    const auto num_results = mode == trace_mode::states ? num_records : mode == trace_mode::outputs ? num_records * num_outputs : 0;
+    run_trace(current_state_id, inputs, results, mode, current_inputs);
+
+    const auto last_inputs = inputs.last(num_inputs);
+    std::copy(last_inputs.begin(), last_inputs.end(), current_inputs.begin());
+    current_outputs_offset = (current_state_id + 1) * num_outputs;
+
+    if(num_results != 0 && sink && sink(std::span<const size_t>(results).first(num_results)) != 0)
+        return 3;
+    return 0;
+}
+int moore_fsm::run_stream(std::span<const std::byte> data, const stream_format& format, const trace_mode& mode, const stream_sink_fn& sink, size_t& num_steps){
+    num_steps = 0;
+    const auto record_bits = format.record_bits == 0 ? num_inputs * format.field_bits : format.record_bits;
+    if(num_inputs == 0 || machine_states.empty() || format.field_bits == 0 || format.field_bits > 64 || record_bits < num_inputs * format.field_bits)
+        return 1;
+
+    //The records are decoded straight from data, a chunk at a time
+    const auto total_records = data.size() * 8 / record_bits;
+    const auto chunk_records = std::min(stream_chunk_records, total_records);
+    std::vector<size_t> input_trace(chunk_records * num_inputs);
+    std::vector<size_t> results(mode == trace_mode::outputs ? chunk_records * num_outputs : chunk_records);
+    while(num_steps < total_records){
+        const auto num_records = std::min(stream_chunk_records, total_records - num_steps);
+        const auto first_bit = num_steps * record_bits;
+
+        //Chunks are a multiple of 8 records long, so every chunk starts on a byte
+        const auto ret_val = run_stream_records(data.subspan(first_bit / 8), num_records, format, mode, sink, input_trace, results);
+        num_steps += num_records;
+        if(ret_val != 0)
+            return ret_val;
+    }
+
+    return 0;
+}
+int moore_fsm::run_stream(const int& fd, const stream_format& format, const trace_mode& mode, const stream_sink_fn& sink, size_t& num_steps){
+    num_steps = 0;
+    const auto record_bits = format.record_bits == 0 ? num_inputs * format.field_bits : format.record_bits;
+    if(num_inputs == 0 || machine_states.empty() || format.field_bits == 0 || format.field_bits > 64 || record_bits < num_inputs * format.field_bits)
+        return 1;
+
+    //The buffer holds a whole chunk of records, which is a multiple of 8 records and so a whole number of bytes.
+    //It is filled completely before being decoded, so records split across two reads are never decoded halfway.
+    const auto chunk_bytes = stream_chunk_records * record_bits / 8;
+    std::vector<std::byte> buffer(chunk_bytes);
+    std::vector<size_t> input_trace(stream_chunk_records * num_inputs);
+    std::vector<size_t> results(mode == trace_mode::outputs ? stream_chunk_records * num_outputs : stream_chunk_records);
+    size_t buffered_bytes = 0;
+    bool end_of_stream = false;
+
+    while(!end_of_stream){
+        while(buffered_bytes < chunk_bytes){
+            const auto read_bytes = read(fd, buffer.data() + buffered_bytes, chunk_bytes - buffered_bytes);
+            if(read_bytes < 0 && errno == EINTR)
+                continue;
+            if(read_bytes < 0)
+                return 2;
+            if(read_bytes == 0){
+                end_of_stream = true;
+                break;
+            }
+            buffered_bytes += read_bytes;
+        }
+
+        //A full buffer is a whole chunk, the last one may end with a partial record, which is ignored
+        const auto num_records = buffered_bytes * 8 / record_bits;
+        if(num_records == 0)
+            break;
+
+        const auto ret_val = run_stream_records(std::span<const std::byte>(buffer).first(buffered_bytes), num_records, format, mode, sink, input_trace, results);
+        num_steps += num_records;
+        if(ret_val != 0)
+            return ret_val;
+
+        buffered_bytes = 0;
+    }
+
+    return 0;
+}
+stream_sink_fn make_fd_sink(const int& fd, const size_t& value_bytes){
+    const auto width = std::clamp<size_t>(value_bytes, 1, 8);
+    return [fd, width, buffer = std::vector<unsigned char>()](std::span<const size_t> results) mutable -> int{
+        buffer.resize(results.size() * width);
+        for(size_t r = 0; r < results.size(); ++r)
+            for(size_t b = 0; b < width; ++b)
+                buffer[r * width + b] = static_cast<unsigned char>(results[r] >> (8 * b));
+
+        size_t written_bytes = 0;
+        while(written_bytes < buffer.size()){
+            const auto ret_val = write(fd, buffer.data() + written_bytes, buffer.size() - written_bytes);
+            if(ret_val < 0 && errno == EINTR)
+                continue;
+            if(ret_val <= 0)
+                return 1;
+            written_bytes += ret_val;
+        }
+        return 0;
+    };
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+//Compiling the machine into a transition table
+int moore_fsm::set_input_alphabet_size(const size_t& input_id, const size_t& alphabet_size){
+    if(input_id >= num_inputs)
+        return 1;
+
+    input_alphabet_sizes[input_id] = alphabet_size;
+    compiled = false;
+
+    //Recompute the strides of the mixed radix encoding
+    num_encoded_inputs = 1;
+    for(size_t i = 0; i < num_inputs; ++i){
+        input_strides[i] = num_encoded_inputs;
+        num_encoded_inputs *= input_alphabet_sizes[i];
+    }
+
+    return 0;
+}
+int moore_fsm::set_input_alphabet_size(std::string_view name, const size_t& alphabet_size){
+    const auto id = name_input_id_map.get_id(name);
+    if(id == static_cast<size_t>(-1))
+        return 1;
+
+    return set_input_alphabet_size(id, alphabet_size);
+}
+size_t moore_fsm::get_input_alphabet_size(const size_t& input_id) const {
+    if(input_id >= num_inputs)
+        return 0;
+
+    return input_alphabet_sizes[input_id];
+}
+size_t moore_fsm::encode_inputs(std::span<const size_t> in) const {
+    if(in.size() != num_inputs)
+        return -1;
+
+    size_t encoded = 0;
+    for(size_t i = 0; i < num_inputs; ++i){
+        if(in[i] >= input_alphabet_sizes[i])
+            return -1;
+        encoded += in[i] * input_strides[i];
+    }
+
+    return encoded;
+}
+int moore_fsm::compile(){
+    //Every input must have a declared, non empty alphabet
+    size_t table_columns = 1;
+    for(size_t i = 0; i < num_inputs; ++i){
+        if(input_alphabet_sizes[i] == 0)
+            return 1;
+        if(table_columns > static_cast<size_t>(-1) / input_alphabet_sizes[i])
+            return 2;
+        table_columns *= input_alphabet_sizes[i];
+    }
+    if(!machine_states.empty() && table_columns > static_cast<size_t>(-1) / machine_states.size())
+        return 2;
+
+    //Probe the transition function of every state with every combination of the inputs.
+    //The probe vector is advanced like an odometer, so that its encoding follows the column index.
+    std::vector<size_t> table(machine_states.size() * table_columns);
+    std::vector<size_t> probe(num_inputs, 0);
+    for(size_t s = 0; s < machine_states.size(); ++s){
+        std::fill(probe.begin(), probe.end(), 0);
+        for(size_t e = 0; e < table_columns; ++e){
+            const auto next_state_id = call_transition_fn(s, probe);
+            table[s * table_columns + e] = next_state_id < machine_states.size() ? next_state_id : static_cast<size_t>(-1);
+
+            for(size_t i = 0; i < num_inputs; ++i){
+                if(++probe[i] < input_alphabet_sizes[i])
+                    break;
+                probe[i] = 0;
+            }
+        }
+    }
+
+    transition_table = std::make_shared<const std::vector<size_t>>(std::move(table));
+    num_encoded_inputs = table_columns;
+    compiled = true;
+    return 0;
+}
+const std::vector<size_t>& moore_fsm::get_transition_table() const {
+    static const std::vector<size_t> empty_table;
+
+    return transition_table ? *transition_table : empty_table;
+}
+bool moore_fsm::is_boolean() const {
+    return num_inputs <= 64 && std::all_of(input_alphabet_sizes.begin(), input_alphabet_sizes.end(), [](const size_t& size){return size == 2;});
+}
+void moore_fsm::decompile(){
+    transition_table.reset();
+    compiled = false;
+}
+
+moore_fsm moore_fsm::from_transition_table(const std::vector<size_t>& input_alphabet_sizes, const size_t& num_outputs, const std::vector<size_t>& state_outputs, std::vector<size_t> transition_table){
+    return from_transition_table(input_alphabet_sizes, num_outputs, state_outputs, std::move(transition_table), {}, {}, {});
+}
+moore_fsm moore_fsm::from_transition_table(const std::vector<size_t>& input_alphabet_sizes, const size_t& num_outputs, const std::vector<size_t>& state_outputs, std::vector<size_t> transition_table,
+                                           const std::vector<std::string>& input_names, const std::vector<std::string>& output_names, const std::vector<std::string>& state_names){
+    const auto num_encoded_inputs = std::accumulate(input_alphabet_sizes.begin(), input_alphabet_sizes.end(), size_t(1), std::multiplies<size_t>());
+    if(num_encoded_inputs == 0)
+        throw std::invalid_argument("moore_fsm::from_transition_table: empty input alphabet");
+    if(transition_table.size() % num_encoded_inputs != 0)
+        throw std::invalid_argument("moore_fsm::from_transition_table: the size of the table isn't a multiple of the number of encoded inputs");
+
+    const auto num_states = transition_table.size() / num_encoded_inputs;
+    if(state_outputs.size() != num_states * num_outputs)
+        throw std::invalid_argument("moore_fsm::from_transition_table: wrong number of state outputs");
+
+    moore_fsm fsm(input_alphabet_sizes.size(), num_outputs, num_states);
+    for(size_t i = 0; i < input_alphabet_sizes.size(); ++i)
+        fsm.set_input_alphabet_size(i, input_alphabet_sizes[i]);
+    for(size_t i = 0; i < std::min(input_names.size(), input_alphabet_sizes.size()); ++i)
+        fsm.set_input_name(i, input_names[i]);
+    for(size_t i = 0; i < std::min(output_names.size(), num_outputs); ++i)
+        fsm.set_output_name(i, output_names[i]);
+
+    //Invalid transitions are normalized to -1
+    for(auto& next_state_id : transition_table)
+        if(next_state_id >= num_states)
+            next_state_id = -1;
+
+    const auto table = std::make_shared<const std::vector<size_t>>(std::move(transition_table));
+    const auto alphabet_sizes = std::make_shared<const std::vector<size_t>>(input_alphabet_sizes);
+    for(size_t s = 0; s < num_states; ++s)
+        fsm.add_state(s < state_names.size() ? state_names[s] : std::string(),
+                      std::vector<size_t>(state_outputs.begin() + s * num_outputs, state_outputs.begin() + (s + 1) * num_outputs),
+                      make_tabulated_transition_fn(table, alphabet_sizes, s));
+
+    //The table is already known, there's no need to probe the transition functions
+    fsm.transition_table = table;
+    fsm.num_encoded_inputs = num_encoded_inputs;
+    fsm.compiled = true;
+    return fsm;
+}
+moore_fsm moore_fsm::from_patterns(const std::vector<std::vector<size_t>>& patterns, const size_t& alphabet_size){
+    std::vector<size_t> shorter_match;
+    return from_patterns(patterns, alphabet_size, shorter_match);
+}
+moore_fsm moore_fsm::from_patterns(const std::vector<std::vector<size_t>>& patterns, const size_t& alphabet_size, std::vector<size_t>& shorter_match){
+    if(alphabet_size == 0)
+        throw std::invalid_argument("moore_fsm::from_patterns: empty alphabet");
+
+    //Trie of the patterns, stored directly in the rows of the transition table: node 0 is the root (nothing matched yet).
+    //terminal[n] is the id + 1 of the first pattern spelled by the path to n, 0 if there's none.
+    std::vector<size_t> table(alphabet_size, -1);
+    std::vector<size_t> terminal(1, 0);
+    for(size_t p = 0; p < patterns.size(); ++p){
+        if(patterns[p].empty())
+            throw std::invalid_argument("moore_fsm::from_patterns: empty pattern");
+
+        size_t node = 0;
+        for(const auto& symbol : patterns[p]){
+            if(symbol >= alphabet_size)
+                throw std::invalid_argument("moore_fsm::from_patterns: symbol outside of the alphabet");
+
+            if(table[node * alphabet_size + symbol] == static_cast<size_t>(-1)){
+                table[node * alphabet_size + symbol] = terminal.size();
+                table.resize(table.size() + alphabet_size, -1);
+                terminal.push_back(0);
+            }
+            node = table[node * alphabet_size + symbol];
+        }
+        if(terminal[node] == 0)
+            terminal[node] = p + 1;
+    }
+    const auto num_nodes = terminal.size();
+
+    //Failure links, in breadth first order so that the failure node of a node, which is shallower, is complete before it.
+    //The missing edges of every node are filled with the ones of its failure node, turning the trie into a DFA.
+    //Outputs of every node: the id + 1 of the longest pattern ending there, and the number of patterns ending there.
+    std::vector<size_t> failure(num_nodes, 0);
+    std::vector<size_t> outputs(num_nodes * 2, 0);
+    std::vector<size_t> queue;
+    queue.reserve(num_nodes);
+    queue.push_back(0);
+    for(size_t q = 0; q < queue.size(); ++q){
+        const auto node = queue[q];
+        const auto fail = failure[node];
+
+        if(node != 0){
+            outputs[node * 2] = terminal[node] != 0 ? terminal[node] : outputs[fail * 2];
+            outputs[node * 2 + 1] = (terminal[node] != 0 ? 1 : 0) + outputs[fail * 2 + 1];
+        }
+
+        for(size_t a = 0; a < alphabet_size; ++a){
+            auto& next = table[node * alphabet_size + a];
+            if(next == static_cast<size_t>(-1))
+                next = node == 0 ? 0 : table[fail * alphabet_size + a];
+            else {
+                failure[next] = node == 0 ? 0 : table[fail * alphabet_size + a];
+                queue.push_back(next);
+            }
+        }
+    }
+
+    //Every pattern links to the longest pattern that is a proper suffix of it, so that all the matches ending at a state
+    //can be listed following the links from its first output. Duplicated patterns are reported with the smallest id.
+    shorter_match.assign(patterns.size(), 0);
+    for(size_t p = 0; p < patterns.size(); ++p){
+        size_t node = 0;
+        for(const auto& symbol : patterns[p])
+            node = table[node * alphabet_size + symbol];
+        shorter_match[p] = outputs[failure[node] * 2];
+    }
+
+    auto fsm = from_transition_table({alphabet_size}, 2, outputs, std::move(table), {"symbol"}, {"match", "num_matches"}, {});
+    fsm.set_current_state(0);
+    return fsm;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+//Optimizing the machine
+int moore_fsm::minimize(moore_fsm& minimized, std::vector<size_t>& old_to_new_state_id) const {
+    if(!compiled)
+        return 1;
+
+    //Hopcroft's partition refinement. Invalid transitions go to an extra "dead" state with id num_states,
+    //which loops on itself and is never equivalent to a real state.
+    const auto num_states = machine_states.size();
+    const auto dead_state = num_states;
+    const auto num_symbols = num_encoded_inputs;
+    const auto& table = *transition_table;
+    const auto delta = [&](const size_t& s, const size_t& a) -> size_t{
+        if(s == dead_state)
+            return dead_state;
+        const auto t = table[s * num_symbols + a];
+        return t < num_states ? t : dead_state;
+    };
+
+    //Inverse transitions, grouped by (target, symbol)
+    std::vector<size_t> pred_start((num_states + 1) * num_symbols + 1, 0);
+    for(size_t s = 0; s <= num_states; ++s)
+        for(size_t a = 0; a < num_symbols; ++a)
+            ++pred_start[delta(s, a) * num_symbols + a + 1];
+    std::partial_sum(pred_start.begin(), pred_start.end(), pred_start.begin());
+    std::vector<size_t> preds(pred_start.back());
+    {
+        auto fill = pred_start;
+        for(size_t s = 0; s <= num_states; ++s)
+            for(size_t a = 0; a < num_symbols; ++a)
+                preds[fill[delta(s, a) * num_symbols + a]++] = s;
+    }
+
+    //Refinable partition: the states of every block are contiguous in elems, block_of and loc allow constant time moves.
+    //The states of a block that are marked during a refinement are moved to [first, mid).
+    struct block{
+        size_t first;
+        size_t mid;
+        size_t end;
+    };
+    std::vector<size_t> elems(num_states + 1);
+    std::vector<size_t> loc(num_states + 1);
+    std::vector<size_t> block_of(num_states + 1);
+    std::vector<block> blocks;
+
+    //Initial partition: states with the same outputs
+    {
+        std::map<std::vector<size_t>, size_t> output_block;
+        std::vector<size_t> block_size;
+        for(size_t s = 0; s <= num_states; ++s){
+            size_t b;
+            if(s == dead_state)
+                b = block_size.size();
+            else {
+                const auto outputs = get_state_outputs(s);
+                b = output_block.try_emplace(std::vector<size_t>(outputs.begin(), outputs.end()), block_size.size()).first->second;
+            }
+            if(b == block_size.size())
+                block_size.push_back(0);
+            block_of[s] = b;
+            ++block_size[b];
+        }
+
+        size_t first = 0;
+        for(const auto& size : block_size){
+            blocks.push_back({first, first, first + size});
+            first += size;
+        }
+        std::vector<size_t> fill(blocks.size());
+        for(size_t b = 0; b < blocks.size(); ++b)
+            fill[b] = blocks[b].first;
+        for(size_t s = 0; s <= num_states; ++s){
+            loc[s] = fill[block_of[s]]++;
+            elems[loc[s]] = s;
+        }
+    }
+
+    std::vector<size_t> worklist(blocks.size());
+    std::iota(worklist.begin(), worklist.end(), 0);
+    std::vector<size_t> splitter;
+    std::vector<size_t> touched;
+
+    while(!worklist.empty()){
+        const auto splitter_block = worklist.back();
+        worklist.pop_back();
+
+        //The splitter may be split while it is being processed, so its states are copied first
+        splitter.assign(elems.begin() + blocks[splitter_block].first, elems.begin() + blocks[splitter_block].end);
+
+        for(size_t a = 0; a < num_symbols; ++a){
+            //Mark the predecessors of the splitter
+            for(const auto& t : splitter){
+                for(size_t p = pred_start[t * num_symbols + a]; p < pred_start[t * num_symbols + a + 1]; ++p){
+                    const auto s = preds[p];
+                    auto& b = blocks[block_of[s]];
+                    if(b.mid == b.first)
+                        touched.push_back(block_of[s]);
+
+                    const auto other = elems[b.mid];
+                    std::swap(elems[loc[s]], elems[b.mid]);
+                    loc[other] = loc[s];
+                    loc[s] = b.mid;
+                    ++b.mid;
+                }
+            }
+
+            //Split the touched blocks: the smaller part becomes a new block and goes into the worklist.
+            //If the old block is still in the worklist, both parts end up in it, as required.
+            for(const auto& b_id : touched){
+                auto& b = blocks[b_id];
+                if(b.mid == b.end){
+                    b.mid = b.first;
+                    continue;
+                }
+
+                block new_block;
+                if(b.mid - b.first <= b.end - b.mid){
+                    new_block = {b.first, b.first, b.mid};
+                    b.first = b.mid;
+                } else {
+                    new_block = {b.mid, b.mid, b.end};
+                    b.end = b.mid;
+                }
+                b.mid = b.first;
+
+                const auto new_id = blocks.size();
+                blocks.push_back(new_block);
+                for(size_t i = new_block.first; i < new_block.end; ++i)
+                    block_of[elems[i]] = new_id;
+                worklist.push_back(new_id);
+            }
+            touched.clear();
+        }
+    }
+
+    //Number the blocks following the smallest old id they contain, so that the order of the states is preserved
+    std::vector<size_t> block_new_id(blocks.size(), -1);
+    std::vector<size_t> representatives;
+    old_to_new_state_id.assign(num_states, -1);
+    for(size_t s = 0; s < num_states; ++s){
+        auto& new_id = block_new_id[block_of[s]];
+        if(new_id == static_cast<size_t>(-1)){
+            new_id = representatives.size();
+            representatives.push_back(s);
+        }
+        old_to_new_state_id[s] = new_id;
+    }
+
+    //Build the minimized machine from the rows of the representatives
+    std::vector<size_t> new_outputs(representatives.size() * num_outputs, 0);
+    std::vector<size_t> new_table(representatives.size() * num_symbols);
+    for(size_t n = 0; n < representatives.size(); ++n){
+        const auto outputs = get_state_outputs(representatives[n]);
+        std::copy(outputs.begin(), outputs.end(), new_outputs.begin() + n * num_outputs);
+        for(size_t a = 0; a < num_symbols; ++a){
+            const auto t = delta(representatives[n], a);
+            new_table[n * num_symbols + a] = t == dead_state ? static_cast<size_t>(-1) : old_to_new_state_id[t];
+        }
+    }
+
+    minimized = from_transition_table(input_alphabet_sizes, num_outputs, new_outputs, std::move(new_table));
+
+    //Every old name is kept and refers to the state its state has been merged into.
+    //The names of the representatives stay the names of the new states, the other ones become aliases.
+    minimized.name_input_id_map = name_input_id_map;
+    minimized.name_output_id_map = name_output_id_map;
+    minimized.name_state_id_map.clear();
+    for(size_t n = 0; n < representatives.size(); ++n)
+        minimized.name_state_id_map.set_name(n, name_state_id_map.get_name(representatives[n]));
+    for(const auto& [name, id] : name_state_id_map)
+        if(!minimized.name_state_id_map.contains(name))
+            minimized.name_state_id_map.add_alias(old_to_new_state_id[id], name);
+
+    minimized.current_inputs = current_inputs;
+    if(current_state_id < num_states)
+        minimized.set_current_state(old_to_new_state_id[current_state_id]);
+
+    return 0;
+}
+
+int moore_fsm::renumber_states(std::span<const size_t> sample_trace, std::vector<size_t>& old_to_new_state_id){
+    const auto num_states = machine_states.size();
+    if(num_inputs == 0 || sample_trace.size() % num_inputs != 0 || num_states == 0)
+        return 1;
+
+    //Run the sample trace from the current state, without changing it, collecting the edges taken
+    std::vector<uint64_t> visits(num_states, 0);
+    std::vector<std::pair<size_t, size_t>> edges;
+    edges.reserve(sample_trace.size() / num_inputs);
+    std::vector<size_t> scratch_inputs;
+    size_t state_id = current_state_id < num_states ? current_state_id : 0;
+    ++visits[state_id];
+    for(size_t k = 0; k < sample_trace.size() / num_inputs; ++k){
+        const auto next_state_id = get_next_state(state_id, sample_trace.subspan(k * num_inputs, num_inputs), scratch_inputs);
+        if(next_state_id >= num_states)
+            continue;
+
+        edges.emplace_back(state_id, next_state_id);
+        ++visits[next_state_id];
+        state_id = next_state_id;
+    }
+
+    //Successors of every state with their frequencies, most frequent first
+    std::sort(edges.begin(), edges.end());
+    struct successor {
+        size_t state_id;
+        uint64_t count;
+    };
+    std::vector<successor> successors;
+    std::vector<size_t> successors_begin(num_states + 1, 0);
+    for(size_t e = 0; e < edges.size(); ++e){
+        if(e == 0 || edges[e] != edges[e - 1]){
+            successors.push_back({edges[e].second, 0});
+            ++successors_begin[edges[e].first + 1];
+        }
+        ++successors.back().count;
+    }
+    std::partial_sum(successors_begin.begin(), successors_begin.end(), successors_begin.begin());
+    for(size_t s = 0; s < num_states; ++s)
+        std::stable_sort(successors.begin() + successors_begin[s], successors.begin() + successors_begin[s + 1],
+                         [](const successor& a, const successor& b){return a.count > b.count;});
+
+    //Greedy chaining: starting from the hottest state not placed yet, every state is followed by its most frequent successor
+    //not placed yet, until the chain can't continue. States never visited keep their relative order at the end.
+    std::vector<size_t> seeds(num_states);
+    std::iota(seeds.begin(), seeds.end(), 0);
+    std::stable_sort(seeds.begin(), seeds.end(), [&](const size_t& a, const size_t& b){return visits[a] > visits[b];});
+
+    old_to_new_state_id.assign(num_states, -1);
+    size_t num_placed = 0;
+    std::vector<size_t> next_successor(successors_begin.begin(), successors_begin.end() - 1);
+    for(const auto& seed : seeds){
+        auto s = seed;
+        while(old_to_new_state_id[s] == static_cast<size_t>(-1)){
+            old_to_new_state_id[s] = num_placed++;
+
+            auto& cursor = next_successor[s];
+            while(cursor < successors_begin[s + 1] && old_to_new_state_id[successors[cursor].state_id] != static_cast<size_t>(-1))
+                ++cursor;
+            if(cursor == successors_begin[s + 1])
+                break;
+            s = successors[cursor].state_id;
+        }
+    }
+
+    remap_states(old_to_new_state_id, num_states);
+    return 0;
+}
+void moore_fsm::remap_states(const std::vector<size_t>& old_to_new_state_id, const size_t& new_num_states){
+    const auto old_num_states = machine_states.size();
+    const auto remap_id = [&](const size_t& old_state_id) -> size_t{
+        const auto new_state_id = old_state_id < old_num_states ? old_to_new_state_id[old_state_id] : -1;
+        return new_state_id < new_num_states ? new_state_id : -1;
+    };
+
+    //The name based transition functions look the states up in the live name table, so they follow the states to their new ids
+    //and see the states added later under a removed name. The handle based ones return the ids they captured, which are translated
+    //to the new ones through the id space of their state. The functions defined since the last remap get a new id space, the id spaces
+    //of the older ones are composed with this remap: the functions are never wrapped, so remapping many times doesn't slow down stepping.
+    //The id spaces are immutable, since they are shared with the copies of the machine.
+    //States mapped to -1 are dropped, and the transitions to them become invalid.
+    std::shared_ptr<const state_id_space> new_id_space;
+    std::unordered_map<const state_id_space*, std::shared_ptr<const state_id_space>> composed_id_spaces;
+    std::vector<state> new_states(new_num_states, state(state_transition_fn()));
+    std::vector<size_t> new_output_arena((new_num_states + 1) * num_outputs, 0);
+    for(size_t s = 0; s < old_num_states; ++s){
+        const auto n = remap_id(s);
+        if(n >= new_num_states)
+            continue;
+
+        auto& old_state = machine_states[s];
+        if(old_state.id_space){
+            auto& composed = composed_id_spaces[old_state.id_space.get()];
+            if(!composed){
+                state_id_space space{old_state.id_space->to_current_state_id};
+                for(auto& id : space.to_current_state_id)
+                    id = remap_id(id);
+                composed = std::make_shared<const state_id_space>(std::move(space));
+            }
+            old_state.id_space = composed;
+        } else if(old_state.handle_fn){
+            if(!new_id_space){
+                state_id_space space{std::vector<size_t>(old_num_states)};
+                for(size_t id = 0; id < old_num_states; ++id)
+                    space.to_current_state_id[id] = remap_id(id);
+                new_id_space = std::make_shared<const state_id_space>(std::move(space));
+            }
+            old_state.id_space = new_id_space;
+        }
+        new_states[n] = std::move(old_state);
+
+        std::copy_n(output_arena.begin() + (s + 1) * num_outputs, num_outputs, new_output_arena.begin() + (n + 1) * num_outputs);
+    }
+
+    if(compiled){
+        std::vector<size_t> new_table(new_num_states * num_encoded_inputs, -1);
+        for(size_t s = 0; s < old_num_states; ++s){
+            const auto n = old_to_new_state_id[s];
+            if(n >= new_num_states)
+                continue;
+
+            for(size_t e = 0; e < num_encoded_inputs; ++e){
+                const auto next_state_id = (*transition_table)[s * num_encoded_inputs + e];
+                new_table[n * num_encoded_inputs + e] = remap_id(next_state_id);
+            }
+        }
+        transition_table = std::make_shared<const std::vector<size_t>>(std::move(new_table));
+    }
+
+    machine_states = std::move(new_states);
+    output_arena = std::move(new_output_arena);
+    name_state_id_map.remap(old_to_new_state_id, new_num_states);
+
+    //A current state that has been dropped leaves the machine without a current state
+    current_state_id = remap_id(current_state_id);
+    current_outputs_offset = current_state_id < new_num_states ? (current_state_id + 1) * num_outputs : 0;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+//Composing machines
+int moore_fsm::compose(const std::vector<const moore_fsm*>& components, const std::vector<std::string>& prefixes, const size_t& max_states, moore_fsm& product){
+    const auto num_components = components.size();
+    if(num_components == 0 || prefixes.size() != num_components)
+        return 1;
+    if(max_states == 0)
+        return 3;
+    for(const auto& c : components)
+        if(c == nullptr || c->current_state_id >= c->machine_states.size())
+            return 1;
+
+    //The inputs of the product are the union of the inputs of the components, matched by name in order of appearance.
+    //component_inputs[c][i] is the product input feeding input i of component c.
+    std::vector<std::string> input_names;
+    std::vector<size_t> input_alphabet_sizes;
+    std::unordered_map<std::string_view, size_t> input_ids;
+    std::vector<std::vector<size_t>> component_inputs(num_components);
+    for(size_t c = 0; c < num_components; ++c){
+        const auto& comp = *components[c];
+        for(size_t i = 0; i < comp.num_inputs; ++i){
+            const auto& name = comp.name_input_id_map.get_name(i);
+            const auto alphabet_size = comp.input_alphabet_sizes[i];
+            if(alphabet_size == 0)
+                return 2;
+
+            const auto [it, inserted] = input_ids.try_emplace(name, input_names.size());
+            if(inserted){
+                input_names.push_back(name);
+                input_alphabet_sizes.push_back(alphabet_size);
+            }
+            else if(input_alphabet_sizes[it->second] != alphabet_size)
+                return 2;
+            component_inputs[c].push_back(it->second);
+        }
+    }
+
+    const auto num_product_inputs = input_names.size();
+    const auto num_encoded_inputs = std::accumulate(input_alphabet_sizes.begin(), input_alphabet_sizes.end(), size_t(1), std::multiplies<size_t>());
+
+    size_t num_product_outputs = 0;
+    for(const auto& c : components)
+        num_product_outputs += c->num_outputs;
+
+    //Breadth first visit of the tuples of component states reachable from the current states.
+    //tuples holds num_components state ids per product state, in order of discovery.
+    std::vector<size_t> tuples;
+    std::unordered_map<std::vector<size_t>, size_t, state_tuple_hash> tuple_ids;
+    std::vector<size_t> table;
+    std::vector<size_t> tuple(num_components);
+    for(size_t c = 0; c < num_components; ++c)
+        tuple[c] = components[c]->current_state_id;
+    tuple_ids.emplace(tuple, 0);
+    tuples.insert(tuples.end(), tuple.begin(), tuple.end());
+
+    std::vector<size_t> product_inputs(num_product_inputs);
+    std::vector<std::vector<size_t>> comp_inputs(num_components);
+    for(size_t c = 0; c < num_components; ++c)
+        comp_inputs[c].resize(component_inputs[c].size());
+    std::vector<size_t> scratch_inputs;
+
+    for(size_t s = 0; s < tuple_ids.size(); ++s){
+        //The inputs are enumerated as an odometer, in the same mixed radix order as the encoding
+        std::fill(product_inputs.begin(), product_inputs.end(), 0);
+        for(size_t e = 0; e < num_encoded_inputs; ++e){
+            size_t next_product_state = -1;
+            bool valid = true;
+            for(size_t c = 0; c < num_components && valid; ++c){
+                for(size_t i = 0; i < comp_inputs[c].size(); ++i)
+                    comp_inputs[c][i] = product_inputs[component_inputs[c][i]];
+
+                tuple[c] = components[c]->get_next_state(tuples[s * num_components + c], comp_inputs[c], scratch_inputs);
+                valid = tuple[c] < components[c]->machine_states.size();
+            }
+
+            if(valid){
+                const auto [it, inserted] = tuple_ids.try_emplace(tuple, tuple_ids.size());
+                if(inserted){
+                    if(tuple_ids.size() > max_states)
+                        return 3;
+                    tuples.insert(tuples.end(), tuple.begin(), tuple.end());
+                }
+                next_product_state = it->second;
+            }
+            table.push_back(next_product_state);
+
+            for(size_t i = 0; i < num_product_inputs && ++product_inputs[i] == input_alphabet_sizes[i]; ++i)
+                product_inputs[i] = 0;
+        }
+    }
+
+    //The outputs of a product state are the outputs of its component states, one component after the other
+    const auto num_product_states = tuple_ids.size();
+    std::vector<size_t> state_outputs;
+    state_outputs.reserve(num_product_states * num_product_outputs);
+    for(size_t s = 0; s < num_product_states; ++s)
+        for(size_t c = 0; c < num_components; ++c){
+            const auto outputs = components[c]->get_state_outputs(tuples[s * num_components + c]);
+            state_outputs.insert(state_outputs.end(), outputs.begin(), outputs.end());
+        }
+
+    product = from_transition_table(input_alphabet_sizes, num_product_outputs, state_outputs, std::move(table));
+
+    //Names of the product: shared input names, outputs prefixed with the prefix of their component and states named after their tuple
+    for(size_t i = 0; i < num_product_inputs; ++i)
+        product.name_input_id_map.set_name(i, input_names[i]);
+
+    size_t output_id = 0;
+    for(size_t c = 0; c < num_components; ++c)
+        for(size_t o = 0; o < components[c]->num_outputs; ++o)
+            product.name_output_id_map.set_name(output_id++, prefixes[c] + "." + components[c]->name_output_id_map.get_name(o));
+
+    std::string state_name;
+    for(size_t s = 0; s < num_product_states; ++s){
+        state_name.clear();
+        for(size_t c = 0; c < num_components; ++c){
+            if(c != 0)
+                state_name += '|';
+            state_name += components[c]->name_state_id_map.get_name(tuples[s * num_components + c]);
+        }
+        product.name_state_id_map.set_name(s, state_name);
+    }
+
+    product.set_current_state(0);
+    return 0;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+//Saving/loading the machine
+int moore_fsm::save_binary(const std::string& path) const {
+    if(!compiled)
+        return 1;
+    //The current state is saved as the initial state of the mapped machine, which must have one
+    if(current_state_id >= machine_states.size())
+        return 3;
+
+    //Lay the sections out one after the other
+    std::string input_chars, output_chars, state_chars;
+    const auto input_names = make_name_table_section(name_input_id_map, num_inputs, input_chars);
+    const auto output_names = make_name_table_section(name_output_id_map, num_outputs, output_chars);
+    const auto state_names = make_name_table_section(name_state_id_map, machine_states.size(), state_chars);
+
+    binary_header header;
+    std::memcpy(header.magic, binary_magic, sizeof(header.magic));
+    header.version = binary_version;
+    header.num_inputs = num_inputs;
+    header.num_outputs = num_outputs;
+    header.num_states = machine_states.size();
+    header.num_encoded_inputs = num_encoded_inputs;
+    header.initial_state_id = current_state_id;
+    header.alphabet_offset = sizeof(binary_header);
+    header.outputs_offset = header.alphabet_offset + num_inputs * sizeof(uint64_t);
+    header.table_offset = header.outputs_offset + machine_states.size() * num_outputs * sizeof(uint64_t);
+    header.input_names_offset = header.table_offset + transition_table->size() * sizeof(uint64_t);
+    header.output_names_offset = header.input_names_offset + name_table_section_size(input_names, input_chars);
+    header.state_names_offset = header.output_names_offset + name_table_section_size(output_names, output_chars);
+    header.file_size = header.state_names_offset + name_table_section_size(state_names, state_chars);
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if(!file)
+        return 2;
+
+    const auto write_values = [&](const auto& values){
+        for(const auto& v : values){
+            const uint64_t value = v;
+            file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+    };
+    const auto write_name_table = [&](const std::vector<uint64_t>& section, const std::string& chars){
+        write_values(section);
+        file.write(chars.data(), chars.size());
+        const char padding[8] = {};
+        file.write(padding, name_table_section_size(section, chars) - section.size() * sizeof(uint64_t) - chars.size());
+    };
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    write_values(input_alphabet_sizes);
+    write_values(std::span<const size_t>(output_arena).subspan(num_outputs, machine_states.size() * num_outputs));
+    write_values(*transition_table);
+    write_name_table(input_names, input_chars);
+    write_name_table(output_names, output_chars);
+    write_name_table(state_names, state_chars);
+
+    return file ? 0 : 2;
+}
+size_t moore_fsm::get_snapshot_size() const {
+    return sizeof(snapshot_header) + (1 + num_inputs) * sizeof(uint64_t);
+}
+int moore_fsm::save_snapshot(std::span<std::byte> buffer) const {
+    if(buffer.size() < get_snapshot_size())
+        return 1;
+
+    const auto header = make_snapshot_header(snapshot_kind_machine, 1, num_inputs, machine_states.size());
+    const uint64_t state_id = current_state_id;
+    std::memcpy(buffer.data(), &header, sizeof(header));
+    std::memcpy(buffer.data() + sizeof(header), &state_id, sizeof(state_id));
+    //The inputs are written as 64 bit words whatever the size of size_t, so snapshots don't depend on the platform
+    for(size_t i = 0; i < num_inputs; ++i){
+        const uint64_t input = current_inputs[i];
+        std::memcpy(buffer.data() + sizeof(header) + (1 + i) * sizeof(uint64_t), &input, sizeof(input));
+    }
+    return 0;
+}
+int moore_fsm::save_snapshot(const std::string& path) const {
+    std::vector<std::byte> buffer(get_snapshot_size());
+    save_snapshot(buffer);
+    return write_snapshot_file(path, buffer);
+}
+int moore_fsm::load_snapshot(std::span<const std::byte> buffer){
+    const auto header = make_snapshot_header(snapshot_kind_machine, 1, num_inputs, machine_states.size());
+    if(!check_snapshot_header(buffer, header, get_snapshot_size()))
+        return 1;
+
+    //A machine may have been saved without a current state
+    uint64_t state_id;
+    std::memcpy(&state_id, buffer.data() + sizeof(header), sizeof(state_id));
+    if(state_id >= machine_states.size() && state_id != static_cast<uint64_t>(-1))
+        return 1;
+
+    current_state_id = state_id < machine_states.size() ? static_cast<size_t>(state_id) : static_cast<size_t>(-1);
+    current_outputs_offset = current_state_id < machine_states.size() ? (current_state_id + 1) * num_outputs : 0;
+    for(size_t i = 0; i < num_inputs; ++i){
+        uint64_t input;
+        std::memcpy(&input, buffer.data() + sizeof(header) + (1 + i) * sizeof(uint64_t), sizeof(input));
+        current_inputs[i] = static_cast<size_t>(input);
+    }
+    return 0;
+}
+int moore_fsm::load_snapshot(const std::string& path){
+    std::vector<std::byte> buffer;
+    if(read_snapshot_file(path, buffer) != 0)
+        return 3;
+
+    return load_snapshot(buffer);
+}
+std::string to_string(const moore_fsm& mfsm){
+    //The transitions are read from the table: an uncompiled machine is written from a compiled copy,
+    //and a machine that can't be compiled isn't written at all, rather than without its transitions
+    if(!mfsm.compiled){
+        auto compiled_fsm = mfsm;
+        if(compiled_fsm.compile() != 0)
+            return {};
+        return to_string(compiled_fsm);
+    }
+
+    std::string ret;
+
+    const auto write_string = [&](std::string_view str){
+        ret += '"';
+        for(const auto& c : str){
+            if(c == '"' || c == '\\'){
+                ret += '\\';
+                ret += c;
+            } else if(static_cast<unsigned char>(c) < 0x20){
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+                ret += escaped;
+            } else
+                ret += c;
+        }
+        ret += '"';
+    };
+    const auto write_names = [&](const symbol_table& names, const size_t& num_ids){
+        ret += '[';
+        for(size_t i = 0; i < num_ids; ++i){
+            if(i != 0)
+                ret += ',';
+            write_string(names.get_name(i));
+        }
+        ret += ']';
+    };
+    const auto write_values = [&](const auto& values){
+        ret += '[';
+        for(size_t i = 0; i < values.size(); ++i){
+            if(i != 0)
+                ret += ',';
+            ret += std::to_string(values[i]);
+        }
+        ret += ']';
+    };
+
+    //Number of inputs, outputs and states and their names
+    const auto num_states = mfsm.machine_states.size();
+    ret += "{\"num_inputs\":" + std::to_string(mfsm.num_inputs);
+    ret += ",\"num_outputs\":" + std::to_string(mfsm.num_outputs);
+    ret += ",\"num_states\":" + std::to_string(num_states);
+    ret += ",\n\"input_names\":";
+    write_names(mfsm.name_input_id_map, mfsm.num_inputs);
+    if(std::all_of(mfsm.input_alphabet_sizes.begin(), mfsm.input_alphabet_sizes.end(), [](const size_t& size){return size != 0;})){
+        ret += ",\n\"input_alphabet\":";
+        write_values(mfsm.input_alphabet_sizes);
+    }
+    ret += ",\n\"output_names\":";
+    write_names(mfsm.name_output_id_map, mfsm.num_outputs);
+    if(mfsm.current_state_id < num_states){
+        ret += ",\n\"initial_state\":";
+        write_string(mfsm.name_state_id_map.get_name(mfsm.current_state_id));
+    }
+
+    //States. The most frequent next state of every state becomes its unguarded default edge
+    //and every other entry of its row becomes an edge guarded by all the inputs.
+    ret += ",\n\"states\":[";
+    std::vector<size_t> next_state_count(num_states + 1, 0);
+    std::vector<size_t> probe(mfsm.num_inputs);
+    for(size_t s = 0; s < num_states; ++s){
+        ret += s == 0 ? "\n" : ",\n";
+        ret += "{\"name\":";
+        write_string(mfsm.name_state_id_map.get_name(s));
+        ret += ",\"outputs\":";
+        write_values(mfsm.get_state_outputs(s));
+
+        const auto row = std::span<const size_t>(*mfsm.transition_table).subspan(s * mfsm.num_encoded_inputs, mfsm.num_encoded_inputs);
+
+        //Invalid transitions are counted as the extra state num_states. Only the counters of the states in the row
+        //are touched and reset, so that writing the machine stays linear in the size of the table. Ties go to the smallest id.
+        for(const auto& next_state_id : row)
+            ++next_state_count[std::min(next_state_id, num_states)];
+        size_t default_next = num_states;
+        size_t default_count = 0;
+        for(const auto& next_state_id : row){
+            const auto id = std::min(next_state_id, num_states);
+            if(next_state_count[id] > default_count || (next_state_count[id] == default_count && id < default_next)){
+                default_next = id;
+                default_count = next_state_count[id];
+            }
+        }
+        for(const auto& next_state_id : row)
+            next_state_count[std::min(next_state_id, num_states)] = 0;
+
+        ret += ",\"edges\":[";
+        bool first_edge = true;
+        std::fill(probe.begin(), probe.end(), 0);
+        for(size_t e = 0; e < row.size(); ++e){
+            const auto next_state_id = std::min(row[e], num_states);
+            if(next_state_id != default_next){
+                ret += first_edge ? "" : ",";
+                first_edge = false;
+                ret += "{\"when\":{";
+                for(size_t i = 0; i < mfsm.num_inputs; ++i){
+                    ret += i == 0 ? "" : ",";
+                    write_string(mfsm.name_input_id_map.get_name(i));
+                    ret += ':' + std::to_string(probe[i]);
+                }
+                ret += "},\"next\":";
+                if(next_state_id == num_states)
+                    ret += "null";
+                else
+                    write_string(mfsm.name_state_id_map.get_name(next_state_id));
+                ret += '}';
+            }
+
+            for(size_t i = 0; i < mfsm.num_inputs; ++i){
+                if(++probe[i] < mfsm.input_alphabet_sizes[i])
+                    break;
+                probe[i] = 0;
+            }
+        }
+        if(default_next != num_states){
+            ret += first_edge ? "" : ",";
+            ret += "{\"next\":";
+            write_string(mfsm.name_state_id_map.get_name(default_next));
+            ret += '}';
+        }
+        ret += ']';
+        ret += '}';
+    }
+
+    ret += "\n]}\n";
+    return ret;
+}
+moore_fsm from_string(std::string_view str){
+    description_parser parser(str);
+
+    //Everything is first collected as views into str, so that the order of the keys doesn't matter
+    //and nothing is allocated per name; the machine is built at the end
+    size_t num_inputs = -1;
+    size_t num_outputs = -1;
+    size_t num_states = -1;
+    std::vector<std::string_view> input_names;
+    std::vector<size_t> input_alphabet;
+    std::vector<std::string_view> output_names;
+    std::string_view initial_state;
+    bool has_initial_state = false;
+
+    struct parsed_guard {
+        std::string_view input;
+        size_t value;
+    };
+    struct parsed_edge {
+        size_t guards_end;
+        std::string_view next;
+        bool is_invalid;
+        bool has_next;
+    };
+    struct parsed_state {
+        std::string_view name;
+        size_t outputs_end;
+        size_t edges_end;
+    };
+    std::vector<parsed_guard> guards;
+    std::vector<parsed_edge> edges;
+    std::vector<size_t> outputs;
+    std::vector<parsed_state> states;
+
+    parser.parse_object([&](std::string_view key){
+        if(key == "num_inputs")
+            num_inputs = parser.parse_number();
+        else if(key == "num_outputs")
+            num_outputs = parser.parse_number();
+        else if(key == "num_states")
+            num_states = parser.parse_number();
+        else if(key == "input_names")
+            parser.parse_array([&]{input_names.push_back(parser.parse_string());});
+        else if(key == "input_alphabet")
+            parser.parse_array([&]{input_alphabet.push_back(parser.parse_number());});
+        else if(key == "output_names")
+            parser.parse_array([&]{output_names.push_back(parser.parse_string());});
+        else if(key == "initial_state"){
+            initial_state = parser.parse_string();
+            has_initial_state = true;
+        }
+        else if(key == "states")
+            parser.parse_array([&]{
+                parsed_state state{};
+                parser.parse_object([&](std::string_view state_key){
+                    if(state_key == "name")
+                        state.name = parser.parse_string();
+                    else if(state_key == "outputs")
+                        parser.parse_array([&]{outputs.push_back(parser.parse_number());});
+                    else if(state_key == "edges")
+                        parser.parse_array([&]{
+                            parsed_edge edge{0, {}, true, false};
+                            parser.parse_object([&](std::string_view edge_key){
+                                if(edge_key == "when")
+                                    parser.parse_object([&](std::string_view input){
+                                        guards.push_back({input, parser.parse_number()});
+                                    });
+                                else if(edge_key == "next"){
+                                    edge.has_next = true;
+                                    edge.is_invalid = parser.parse_null();
+                                    if(!edge.is_invalid)
+                                        edge.next = parser.parse_string();
+                                }
+                                else
+                                    parser.skip_value();
+                            });
+                            if(!edge.has_next)
+                                throw std::invalid_argument("from_string: edge without \"next\"");
+                            edge.guards_end = guards.size();
+                            edges.push_back(edge);
+                        });
+                    else
+                        parser.skip_value();
+                });
+                state.outputs_end = outputs.size();
+                state.edges_end = edges.size();
+                states.push_back(state);
+            });
+        else
+            parser.skip_value();
+    });
+    parser.expect_end();
+
+    if(num_inputs == static_cast<size_t>(-1) || num_outputs == static_cast<size_t>(-1))
+        throw std::invalid_argument("from_string: num_inputs and num_outputs are required");
+    if(input_names.size() > num_inputs || output_names.size() > num_outputs || (!input_alphabet.empty() && input_alphabet.size() != num_inputs))
+        throw std::invalid_argument("from_string: too many input or output names, or wrong number of alphabet sizes");
+    if(num_states != static_cast<size_t>(-1) && num_states != states.size())
+        throw std::invalid_argument("from_string: num_states doesn't match the number of states listed");
+
+    moore_fsm fsm(num_inputs, num_outputs, states.size());
+    for(size_t i = 0; i < input_names.size(); ++i)
+        fsm.set_input_name(i, std::string(input_names[i]));
+    for(size_t i = 0; i < output_names.size(); ++i)
+        fsm.set_output_name(i, std::string(output_names[i]));
+
+    //Declare every state first, so that edges can point to states defined later
+    std::vector<size_t> state_ids(states.size());
+    for(size_t s = 0; s < states.size(); ++s){
+        state_ids[s] = fsm.declare_state(std::string(states[s].name));
+        if(state_ids[s] != s)
+            throw std::invalid_argument("from_string: duplicate state name");
+    }
+
+    //The edges of all the states are stored once, with names resolved to ids, and shared by the transition functions
+    struct edge_table {
+        std::vector<size_t> guard_inputs;
+        std::vector<size_t> guard_values;
+        std::vector<size_t> edge_guards_end;
+        std::vector<size_t> edge_next;      //-1 for invalid transitions
+    };
+    auto table = std::make_shared<edge_table>();
+    table->guard_inputs.reserve(guards.size());
+    table->guard_values.reserve(guards.size());
+    for(const auto& guard : guards){
+        const auto input_id = fsm.get_input_id(guard.input);
+        if(input_id == static_cast<size_t>(-1))
+            throw std::invalid_argument("from_string: unknown input \"" + std::string(guard.input) + "\"");
+        table->guard_inputs.push_back(input_id);
+        table->guard_values.push_back(guard.value);
+    }
+    table->edge_guards_end.reserve(edges.size());
+    table->edge_next.reserve(edges.size());
+    for(const auto& edge : edges){
+        const auto next_state_id = edge.is_invalid ? static_cast<size_t>(-1) : fsm.get_state_id(edge.next);
+        if(!edge.is_invalid && next_state_id == static_cast<size_t>(-1))
+            throw std::invalid_argument("from_string: unknown state \"" + std::string(edge.next) + "\"");
+        table->edge_guards_end.push_back(edge.guards_end);
+        table->edge_next.push_back(next_state_id);
+    }
+
+    std::shared_ptr<const edge_table> edges_ptr = table;
+    size_t outputs_begin = 0;
+    size_t edges_begin = 0;
+    for(size_t s = 0; s < states.size(); ++s){
+        const auto edges_end = states[s].edges_end;
+        std::vector<size_t> state_outputs(outputs.begin() + outputs_begin, outputs.begin() + states[s].outputs_end);
+        if(state_outputs.size() != num_outputs)
+            throw std::invalid_argument("from_string: wrong number of outputs for state \"" + std::string(states[s].name) + "\"");
+
+        //The first edge whose guards all match is taken
+        fsm.define_state(s, state_outputs, [edges_ptr, edges_begin, edges_end](input_view inputs) -> size_t{
+            const auto& t = *edges_ptr;
+            size_t guard = edges_begin == 0 ? 0 : t.edge_guards_end[edges_begin - 1];
+            for(size_t e = edges_begin; e < edges_end; ++e){
+                bool match = true;
+                for(; guard < t.edge_guards_end[e]; ++guard)
+                    match = match && t.guard_inputs[guard] < inputs.size() && inputs[t.guard_inputs[guard]] == t.guard_values[guard];
+                if(match)
+                    return t.edge_next[e];
+            }
+            return -1;
+        });
+
+        outputs_begin = states[s].outputs_end;
+        edges_begin = edges_end;
+    }
+
+    if(has_initial_state && fsm.set_current_state(initial_state) != 0)
+        throw std::invalid_argument("from_string: unknown initial state \"" + std::string(initial_state) + "\"");
+
+    //With a declared alphabet, the machine is compiled right away
+    if(!input_alphabet.empty()){
+        for(size_t i = 0; i < num_inputs; ++i)
+            fsm.set_input_alphabet_size(i, input_alphabet[i]);
+        fsm.compile();
+    }
+
+    return fsm;
+}
+
+//==========================================================================================================================================
+//shared_moore_fsm
+//==========================================================================================================================================
+//------------------------------------------------------------------------------------------------------------------------------------------
+//Constructor
+shared_moore_fsm::shared_moore_fsm(moore_fsm fsm) :
+    definition(std::make_shared<const moore_fsm>(std::move(fsm))),
+    version(1)
+{}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+//Publishing and reading the definition
+void shared_moore_fsm::publish(moore_fsm fsm){
+    //The definition is stored before the version is bumped, so a reader seeing the new version loads at least the new definition
+    definition.store(std::make_shared<const moore_fsm>(std::move(fsm)), std::memory_order_release);
+    version.fetch_add(1, std::memory_order_acq_rel);
+}
+
+//==========================================================================================================================================
+//moore_fsm_reader
+//==========================================================================================================================================
+//------------------------------------------------------------------------------------------------------------------------------------------
+//Constructor
+moore_fsm_reader::moore_fsm_reader(const shared_moore_fsm& source, const state_migration& migration) :
+    source(&source),
+    version(source.get_version()),
+    migration(migration)
+{
+    definition = source.get_definition();
+    current_state_id = definition->current_state_id;
+    current_inputs.assign(definition->num_inputs, 0);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+//Getter/setter of I/O
+int moore_fsm_reader::set_input(const size_t& id, const size_t& value){
+    if(id >= current_inputs.size())
+        return 1;
+
+    current_inputs[id] = value;
+    return 0;
+}
+int moore_fsm_reader::set_input(std::string_view name, const size_t& value){
+    return set_input(definition->get_input_id(name), value);
+}
+int moore_fsm_reader::set_inputs(const std::vector<size_t>& in){
+    const auto num_copied = std::min(in.size(), current_inputs.size());
+    std::copy_n(in.begin(), num_copied, current_inputs.begin());
+
+    if(in.size() < current_inputs.size())
+        return 1;
+    else if(in.size() > current_inputs.size())
+        return 2;
+    else
+        return 0;
+}
+size_t moore_fsm_reader::get_output(const size_t& id) const {
+    if(id >= definition->num_outputs)
+        return -1;
+
+    return get_outputs()[id];
+}
+size_t moore_fsm_reader::get_output(std::string_view name) const {
+    return get_output(definition->get_output_id(name));
+}
+std::span<const size_t> moore_fsm_reader::get_outputs() const {
+    //Without a current state, the outputs are the row of zeros at the beginning of the arena
+    const auto num_outputs = definition->num_outputs;
+    const auto offset = current_state_id < definition->get_num_states() ? (current_state_id + 1) * num_outputs : 0;
+    return std::span<const size_t>(definition->output_arena).subspan(offset, num_outputs);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+//Simulation of the machine
+int moore_fsm_reader::set_current_state(const size_t& state_id){
+    if(state_id >= definition->get_num_states())
+        return 1;
+
+    current_state_id = state_id;
+    return 0;
+}
+int moore_fsm_reader::set_current_state(std::string_view name){
+    return set_current_state(definition->get_state_id(name));
+}
+std::string moore_fsm_reader::get_current_state_name() const {
+    return definition->get_state_name(current_state_id);
+}
+size_t moore_fsm_reader::step_machine(){
+    const auto next_state_id = definition->get_next_state(current_state_id, current_inputs, scratch_inputs);
+    if(next_state_id >= definition->get_num_states())
+        return -1;
+
+    current_state_id = next_state_id;
+    return current_state_id;
+}
+size_t moore_fsm_reader::step_machine(const size_t& num_steps){
+    size_t ret_val = 0;
+
+    for(size_t i = 0; i < num_steps; ++i)
+        ret_val = step_machine();
+
+    return ret_val;
+}
+size_t moore_fsm_reader::run(std::span<const size_t> input_trace, std::span<size_t> output_trace, const trace_mode& mode){
+    const auto num_steps = definition->get_trace_steps(input_trace, output_trace, mode);
+    if(num_steps == static_cast<size_t>(-1))
+        return -1;
+
+    const auto ret_val = definition->run_trace(current_state_id, input_trace, output_trace, mode, scratch_inputs);
+    if(num_steps != 0){
+        const auto last_inputs = input_trace.last(current_inputs.size());
+        std::copy(last_inputs.begin(), last_inputs.end(), current_inputs.begin());
+    }
+
+    return ret_val;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+//Picking up new definitions
+int moore_fsm_reader::refresh(){
+    //Cheap check first: the shared pointer is loaded only when something has been published
+    const auto latest_version = source->get_version();
+    if(latest_version == version)
+        return 0;
+
+    auto latest = source->get_definition();
+    version = latest_version;
+    if(latest == definition)
+        return 0;
+
+    //The current state is carried over following the migration policy, and falls back to the initial state of the new definition
+    size_t state_id = -1;
+    if(migration == state_migration::by_name && current_state_id < definition->get_num_states())
+        state_id = latest->get_state_id(definition->get_state_name(current_state_id));
+    else if(migration == state_migration::by_id)
+        state_id = current_state_id;
+
+    int ret_val = 0;
+    if(state_id >= latest->get_num_states()){
+        if(migration != state_migration::reset && current_state_id < definition->get_num_states())
+            ret_val = 1;
+        state_id = latest->current_state_id;
+    }
+
+    //Inputs are kept by id, the ones added by the new definition start from 0
+    current_inputs.resize(latest->num_inputs, 0);
+    current_state_id = state_id;
+    definition = std::move(latest);
+
+    return ret_val;
+}
+
+//==========================================================================================================================================
+//mealy_fsm
+//==========================================================================================================================================
+//------------------------------------------------------------------------------------------------------------------------------------------
+//Constructor
+mealy_fsm::mealy_fsm(const std::vector<size_t>& _input_alphabet_sizes, const size_t& _num_outputs, const size_t& _num_states) :
+num_inputs(_input_alphabet_sizes.size()), num_outputs(_num_outputs), num_states(0), current_state_id(0), input_alphabet_sizes(_input_alphabet_sizes)
+{
+    //Configure inputs, their names and their encoding
+    current_inputs = std::vector<size_t>(num_inputs, 0);
+    input_strides = std::vector<size_t>(num_inputs, 0);
+    name_input_id_map.reserve(num_inputs);
+    num_encoded_inputs = 1;
+    for(size_t i = 0; i < num_inputs; ++i){
+        name_input_id_map.set_name(i, std::to_string(i));
+        input_strides[i] = num_encoded_inputs;
+        num_encoded_inputs *= input_alphabet_sizes[i];
+    }
+
+    //Configure outputs and their names
+    current_outputs = std::vector<size_t>(num_outputs, 0);
+    name_output_id_map.reserve(num_outputs);
+    for(size_t i = 0; i < num_outputs; ++i)
+        name_output_id_map.set_name(i, std::to_string(i));
+
+    //Pre allocate space for the states
+    next_state_table.reserve(_num_states * num_encoded_inputs);
+    output_table.reserve(_num_states * num_encoded_inputs * num_outputs);
+    name_state_id_map.reserve(_num_states);
+}
+
+size_t mealy_fsm::get_input_alphabet_size(const size_t& input_id) const {
+    if(input_id >= num_inputs)
+        return 0;
+
+    return input_alphabet_sizes[input_id];
+}
+size_t mealy_fsm::encode_inputs(std::span<const size_t> in) const {
+    if(in.size() != num_inputs)
+        return -1;
+
+    size_t encoded = 0;
+    for(size_t i = 0; i < num_inputs; ++i){
+        if(in[i] >= input_alphabet_sizes[i])
+            return -1;
+        encoded += in[i] * input_strides[i];
+    }
+
+    return encoded;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+//Getter/setter of I/O
+int mealy_fsm::set_input(const size_t& id, const size_t& value){
+    if(id >= num_inputs)
+        return 1;
+
+    current_inputs[id] = value;
+    return 0;
+}
+int mealy_fsm::set_input(std::string_view name, const size_t& value){
+    const auto id = name_input_id_map.get_id(name);
+    if(id == static_cast<size_t>(-1))
+        return 1;
+
+    current_inputs[id] = value;
+    return 0;
+}
+int mealy_fsm::set_inputs(const std::vector<size_t>& in){
+    if(in.size() < current_inputs.size()){
+        std::copy(in.begin(), in.end(), current_inputs.begin());
+        return 1;
+    }
+    else if(in.size() > current_inputs.size()){
+        std::copy_n(in.begin(), current_inputs.size(), current_inputs.begin());
+        return 2;
+    }
+    else {
+        std::copy(in.begin(), in.end(), current_inputs.begin());
+        return 0;
+    }
+}
+size_t mealy_fsm::get_output(const size_t& id) const {
+    if(id >= num_outputs)
+        return -1;
+
+    return current_outputs[id];
+}
+size_t mealy_fsm::get_output(std::string_view name) const {
+    const auto id = name_output_id_map.get_id(name);
+    if(id == static_cast<size_t>(-1))
+        return -1;
+
+    return current_outputs[id];
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+//Associating names to inputs
+int mealy_fsm::set_input_name(const size_t& input_id, const std::string& name){
+    if(input_id >= num_inputs)
+        return 1;
+
+    name_input_id_map.set_name(input_id, name);
+    return 0;
+}
+std::string mealy_fsm::get_input_name(const size_t& input_id) const {
+    return name_input_id_map.get_name(input_id);
+}
+size_t mealy_fsm::get_input_id(std::string_view name) const {
+    return name_input_id_map.get_id(name);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+//Associating names to outpus
+int mealy_fsm::set_output_name(const size_t& output_id, const std::string& name){
+    if(output_id >= num_outputs)
+        return 1;
+
+    name_output_id_map.set_name(output_id, name);
+    return 0;
+}
+std::string mealy_fsm::get_output_name(const size_t& output_id) const {
+    return name_output_id_map.get_name(output_id);
+}
+size_t mealy_fsm::get_output_id(std::string_view name) const {
+    return name_output_id_map.get_id(name);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+//Adding states and transitions
+size_t mealy_fsm::add_state(){
+    return add_state("");
+}
+size_t mealy_fsm::add_state(const std::string& name){
+    //A new state has all its transitions invalid
+    next_state_table.resize(next_state_table.size() + num_encoded_inputs, -1);
+    output_table.resize(output_table.size() + num_encoded_inputs * num_outputs, 0);
+
+    const auto last_state_id = num_states++;
+    if(name.empty())
+        set_state_name(last_state_id, std::to_string(last_state_id));
+    else
+        set_state_name(last_state_id, name);
+
+    return last_state_id;
+}
+int mealy_fsm::set_transition(const size_t& state_id, const std::vector<size_t>& inputs, const size_t& next_state_id, const std::vector<size_t>& outputs){
+    const auto encoded_inputs = encode_inputs(inputs);
+    if(state_id >= num_states || encoded_inputs == static_cast<size_t>(-1))
+        return 1;
+    if(outputs.size() != num_outputs)
+        return 2;
+
+    //Next states are not checked, so that transitions can point to states that will be added later
+    const auto entry = state_id * num_encoded_inputs + encoded_inputs;
+    next_state_table[entry] = next_state_id;
+    std::copy(outputs.begin(), outputs.end(), output_table.begin() + entry * num_outputs);
+    return 0;
+}
+int mealy_fsm::set_transitions(const size_t& state_id, const mealy_transition_fn& transition_fn){
+    if(state_id >= num_states)
+        return 1;
+
+    //Probe the transition function with every combination of the inputs, advancing the probe like an odometer
+    std::vector<size_t> probe(num_inputs, 0);
+    for(size_t e = 0; e < num_encoded_inputs; ++e){
+        const auto transition = transition_fn(input_view(probe));
+        const auto entry = state_id * num_encoded_inputs + e;
+
+        next_state_table[entry] = transition.next_state;
+
+        //Outputs missing from the transition are 0, extra ones are ignored
+        const auto slot = output_table.begin() + entry * num_outputs;
+        const auto num_copied = std::min(num_outputs, transition.outputs.size());
+        std::copy_n(transition.outputs.begin(), num_copied, slot);
+        std::fill(slot + num_copied, slot + num_outputs, 0);
+
+        for(size_t i = 0; i < num_inputs; ++i){
+            if(++probe[i] < input_alphabet_sizes[i])
+                break;
+            probe[i] = 0;
+        }
+    }
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+//Associating names to states
+int mealy_fsm::set_state_name(const size_t& state_id, const std::string& name){
+    if(state_id >= num_states)
+        return 1;
+
+    name_state_id_map.set_name(state_id, name);
+    return 0;
+}
+std::string mealy_fsm::get_state_name(const size_t& state_id) const {
+    return name_state_id_map.get_name(state_id);
+}
+size_t mealy_fsm::get_state_id(std::string_view name) const {
+    return name_state_id_map.get_id(name);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+//Simulation of the machine
+int mealy_fsm::set_current_state(const size_t& state_id){
+    if(state_id >= num_states)
+        return 1;
+
+    current_state_id = state_id;
+    return 0;
+}
+int mealy_fsm::set_current_state(std::string_view name){
+    const auto id = name_state_id_map.get_id(name);
+    if(id == static_cast<size_t>(-1))
+        return 1;
+
+    return set_current_state(id);
+}
+std::string mealy_fsm::get_current_state_name() const {
+    return name_state_id_map.get_name(current_state_id);
+}
+size_t mealy_fsm::step_machine(){
+    const auto encoded_inputs = encode_inputs(current_inputs);
+    if(encoded_inputs == static_cast<size_t>(-1) || current_state_id >= num_states)
+        return -1;
+
+    const auto entry = current_state_id * num_encoded_inputs + encoded_inputs;
+    const auto next_state_id = next_state_table[entry];
+    if(next_state_id >= num_states)
+        return -1;
+
+    current_state_id = next_state_id;
+    std::copy_n(output_table.begin() + entry * num_outputs, num_outputs, current_outputs.begin());
+
+    return current_state_id;
+}
+size_t mealy_fsm::step_machine(const size_t& num_steps){
+    size_t ret_val = 0;
+
+    for(size_t i = 0; i < num_steps; ++i)
+        ret_val = step_machine();
+
+    return ret_val;
+}
+size_t mealy_fsm::run(std::span<const size_t> input_trace, std::span<size_t> output_trace, const trace_mode& mode){
+    if(num_inputs == 0 || input_trace.size() % num_inputs != 0 || current_state_id >= num_states)
+        return -1;
+
+    const auto num_steps = input_trace.size() / num_inputs;
+    if(mode == trace_mode::states && output_trace.size() < num_steps)
+        return -1;
+    if(mode == trace_mode::outputs && output_trace.size() < num_steps * num_outputs)
+        return -1;
+
+    //last_entry is the table entry of the last valid transition, whose outputs become the current outputs at the end
+    size_t ret_val = current_state_id;
+    size_t last_entry = -1;
+    for(size_t k = 0; k < num_steps; ++k){
+        const auto encoded_inputs = encode_inputs(input_trace.subspan(k * num_inputs, num_inputs));
+        const auto entry = current_state_id * num_encoded_inputs + encoded_inputs;
+        const size_t next_state_id = encoded_inputs != static_cast<size_t>(-1) ? next_state_table[entry] : -1;
+
+        //Same behaviour as step_machine: an invalid transition leaves the machine and its outputs as they are
+        if(next_state_id < num_states){
+            current_state_id = next_state_id;
+            last_entry = entry;
+            ret_val = current_state_id;
+        } else
+            ret_val = -1;
+
+        if(mode == trace_mode::states)
+            output_trace[k] = ret_val;
+        else if(mode == trace_mode::outputs){
+            if(last_entry != static_cast<size_t>(-1))
+                std::copy_n(output_table.begin() + last_entry * num_outputs, num_outputs, output_trace.begin() + k * num_outputs);
+            else
+                std::copy(current_outputs.begin(), current_outputs.end(), output_trace.begin() + k * num_outputs);
+        }
+    }
+
+    if(num_steps != 0){
+        const auto last_inputs = input_trace.last(num_inputs);
+        std::copy(last_inputs.begin(), last_inputs.end(), current_inputs.begin());
+    }
+    if(last_entry != static_cast<size_t>(-1))
+        std::copy_n(output_table.begin() + last_entry * num_outputs, num_outputs, current_outputs.begin());
+
+    return ret_val;
+}
+
+//==========================================================================================================================================
+//moore_fsm_bank
+//==========================================================================================================================================
+//------------------------------------------------------------------------------------------------------------------------------------------
+//Constructor
+moore_fsm_bank::moore_fsm_bank(const moore_fsm& fsm, const size_t& num_instances) :
+num_inputs(fsm.get_num_inputs()), num_outputs(fsm.get_num_outputs()), num_states(fsm.get_num_states()), num_encoded_inputs(fsm.get_num_encoded_inputs())
+{
+    if(!fsm.is_compiled())
+        throw std::invalid_argument("moore_fsm_bank: the machine must be compiled");
+    if(num_states == 0 || num_states * num_encoded_inputs >= invalid_state)
+        throw std::invalid_argument("moore_fsm_bank: the transition table doesn't fit 32 bit indices");
+    if(fsm.get_current_state_id() >= num_states)
+        throw std::invalid_argument("moore_fsm_bank: the machine has no current state to start the instances from");
+
+    //Copy the definition of the machine
+    input_alphabet_sizes.resize(num_inputs);
+    input_strides.resize(num_inputs);
+    size_t stride = 1;
+    for(size_t i = 0; i < num_inputs; ++i){
+        input_alphabet_sizes[i] = fsm.get_input_alphabet_size(i);
+        input_strides[i] = stride;
+        stride *= input_alphabet_sizes[i];
+    }
+
+    const auto& table = fsm.get_transition_table();
+    transition_table.resize(table.size());
+    std::transform(table.begin(), table.end(), transition_table.begin(), [](const size_t& next_state_id) -> uint32_t{
+        return next_state_id == static_cast<size_t>(-1) ? invalid_state : static_cast<uint32_t>(next_state_id);
+    });
+
+    state_outputs.resize(num_states * num_outputs, 0);
+    for(size_t s = 0; s < num_states; ++s){
+        const auto outputs = fsm.get_state_outputs(s);
+        std::copy_n(outputs.begin(), std::min(num_outputs, outputs.size()), state_outputs.begin() + s * num_outputs);
+    }
+
+    //Every instance starts from the current state and inputs of the machine
+    const auto encoded_inputs = fsm.encode_inputs(fsm.get_inputs());
+    current_state_ids = std::vector<uint32_t>(num_instances, static_cast<uint32_t>(fsm.get_current_state_id()));
+    current_encoded_inputs = std::vector<uint32_t>(num_instances, encoded_inputs == static_cast<size_t>(-1) ? 0 : static_cast<uint32_t>(encoded_inputs));
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+//Getter/setter of I/O
+int moore_fsm_bank::set_input(const size_t& instance, const size_t& id, const size_t& value){
+    if(instance >= current_state_ids.size() || id >= num_inputs)
+        return 1;
+    if(value >= input_alphabet_sizes[id])
+        return 2;
+
+    //Replace the digit of the input inside the encoding
+    const auto old_value = get_input(instance, id);
+    current_encoded_inputs[instance] = static_cast<uint32_t>(current_encoded_inputs[instance] - old_value * input_strides[id] + value * input_strides[id]);
+    return 0;
+}
+int moore_fsm_bank::set_inputs(const size_t& instance, const std::vector<size_t>& in){
+    if(instance >= current_state_ids.size() || in.size() != num_inputs)
+        return 1;
+
+    size_t encoded = 0;
+    for(size_t i = 0; i < num_inputs; ++i){
+        if(in[i] >= input_alphabet_sizes[i])
+            return 2;
+        encoded += in[i] * input_strides[i];
+    }
+
+    current_encoded_inputs[instance] = static_cast<uint32_t>(encoded);
+    return 0;
+}
+int moore_fsm_bank::set_encoded_inputs(const size_t& instance, const size_t& encoded_inputs){
+    if(instance >= current_state_ids.size())
+        return 1;
+    if(encoded_inputs >= num_encoded_inputs)
+        return 2;
+
+    current_encoded_inputs[instance] = static_cast<uint32_t>(encoded_inputs);
+    return 0;
+}
+size_t moore_fsm_bank::get_input(const size_t& instance, const size_t& id) const {
+    if(instance >= current_state_ids.size() || id >= num_inputs)
+        return -1;
+
+    return (current_encoded_inputs[instance] / input_strides[id]) % input_alphabet_sizes[id];
+}
+size_t moore_fsm_bank::get_output(const size_t& instance, const size_t& id) const {
+    if(instance >= current_state_ids.size() || id >= num_outputs)
+        return -1;
+
+    return state_outputs[current_state_ids[instance] * num_outputs + id];
+}
+std::span<const size_t> moore_fsm_bank::get_outputs(const size_t& instance) const {
+    if(instance >= current_state_ids.size())
+        return {};
+
+    return std::span<const size_t>(state_outputs).subspan(current_state_ids[instance] * num_outputs, num_outputs);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+//Simulation of the instances
+int moore_fsm_bank::set_current_state(const size_t& instance, const size_t& state_id){
+    if(instance >= current_state_ids.size() || state_id >= num_states)
+        return 1;
+
+    current_state_ids[instance] = static_cast<uint32_t>(state_id);
+    return 0;
+}
+int moore_fsm_bank::set_all_current_states(const size_t& state_id){
+    if(state_id >= num_states)
+        return 1;
+
+    std::fill(current_state_ids.begin(), current_state_ids.end(), static_cast<uint32_t>(state_id));
+    return 0;
+}
+size_t moore_fsm_bank::get_current_state_id(const size_t& instance) const {
+    if(instance >= current_state_ids.size())
+        return -1;
+
+    return current_state_ids[instance];
+}
+void moore_fsm_bank::step_all(){
+    //Branch free kernel: one gather from the table per instance, invalid transitions keep the current state.
+    //Everything is 32 bit wide so that the compiler can vectorize the loop with gather instructions.
+    const uint32_t* const table = transition_table.data();
+    const uint32_t* const inputs = current_encoded_inputs.data();
+    uint32_t* const states = current_state_ids.data();
+    const auto row_size = static_cast<uint32_t>(num_encoded_inputs);
+    const auto n = current_state_ids.size();
+
+    for(size_t i = 0; i < n; ++i){
+        const uint32_t next_state_id = table[states[i] * row_size + inputs[i]];
+        states[i] = next_state_id != invalid_state ? next_state_id : states[i];
+    }
+}
+void moore_fsm_bank::step_all(const size_t& num_steps){
+    for(size_t i = 0; i < num_steps; ++i)
+        step_all();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+//Snapshots of the run state
+size_t moore_fsm_bank::get_snapshot_size() const {
+    return sizeof(snapshot_header) + (current_state_ids.size() * 2 * sizeof(uint32_t) + 7) / 8 * 8;
+}
+int moore_fsm_bank::save_snapshot(std::span<std::byte> buffer) const {
+    if(buffer.size() < get_snapshot_size())
+        return 1;
+
+    const auto header = make_snapshot_header(snapshot_kind_bank, current_state_ids.size(), num_inputs, num_states);
+    const auto array_size = current_state_ids.size() * sizeof(uint32_t);
+    std::memcpy(buffer.data(), &header, sizeof(header));
+    std::memcpy(buffer.data() + sizeof(header), current_state_ids.data(), array_size);
+    std::memcpy(buffer.data() + sizeof(header) + array_size, current_encoded_inputs.data(), array_size);
+    std::fill(buffer.begin() + sizeof(header) + 2 * array_size, buffer.begin() + get_snapshot_size(), std::byte{0});
+    return 0;
+}
+int moore_fsm_bank::save_snapshot(const std::string& path) const {
+    std::vector<std::byte> buffer(get_snapshot_size());
+    save_snapshot(buffer);
+    return write_snapshot_file(path, buffer);
+}
+int moore_fsm_bank::load_snapshot(std::span<const std::byte> buffer){
+    const auto header = make_snapshot_header(snapshot_kind_bank, current_state_ids.size(), num_inputs, num_states);
+    if(!check_snapshot_header(buffer, header, get_snapshot_size()))
+        return 1;
+
+    //Every value is checked before anything is overwritten, so a corrupted snapshot leaves the bank untouched
+    const auto n = current_state_ids.size();
+    const auto array_size = n * sizeof(uint32_t);
+    const auto* const states = buffer.data() + sizeof(header);
+    const auto* const inputs = states + array_size;
+    const auto state_limit = static_cast<uint32_t>(num_states);
+    const auto inputs_limit = static_cast<uint32_t>(num_encoded_inputs);
+    uint32_t invalid = 0;
+    for(size_t i = 0; i < n; ++i){
+        uint32_t state_id, encoded_inputs;
+        std::memcpy(&state_id, states + i * sizeof(uint32_t), sizeof(state_id));
+        std::memcpy(&encoded_inputs, inputs + i * sizeof(uint32_t), sizeof(encoded_inputs));
+        invalid |= static_cast<uint32_t>(state_id >= state_limit) | static_cast<uint32_t>(encoded_inputs >= inputs_limit);
+    }
+    if(invalid != 0)
+        return 1;
+
+    std::memcpy(current_state_ids.data(), states, array_size);
+    std::memcpy(current_encoded_inputs.data(), inputs, array_size);
+    return 0;
+}
+int moore_fsm_bank::load_snapshot(const std::string& path){
+    std::vector<std::byte> buffer;
+    if(read_snapshot_file(path, buffer) != 0)
+        return 3;
+
+    return load_snapshot(buffer);
+}
+
+
+//==========================================================================================================================================
+//moore_fsm_bitsliced_bank
+//==========================================================================================================================================
+//------------------------------------------------------------------------------------------------------------------------------------------
+//Constructor
+moore_fsm_bitsliced_bank::moore_fsm_bitsliced_bank(const moore_fsm& fsm, const size_t& _num_instances) :
+num_inputs(fsm.get_num_inputs()), num_outputs(fsm.get_num_outputs()), num_states(fsm.get_num_states()), num_encoded_inputs(fsm.get_num_encoded_inputs()),
+num_state_bits(0), num_instances(_num_instances), num_words((_num_instances + 63) / 64)
+{
+    if(!fsm.is_compiled() || !fsm.is_boolean())
+        throw std::invalid_argument("moore_fsm_bitsliced_bank: the machine must be compiled and every input alphabet must have size 2");
+    if(num_states == 0 || num_inputs > 16 || num_outputs > 64 || num_states > (size_t(1) << 16))
+        throw std::invalid_argument("moore_fsm_bitsliced_bank: the machine has no states, or too many states, inputs or outputs");
+    if(fsm.get_current_state_id() >= num_states)
+        throw std::invalid_argument("moore_fsm_bitsliced_bank: the machine has no current state to start the instances from");
+
+    while((size_t(1) << num_state_bits) < num_states)
+        ++num_state_bits;
+
+    //Copy the definition of the machine
+    const auto& table = fsm.get_transition_table();
+    transition_table.resize(table.size());
+    for(size_t e = 0; e < table.size(); ++e)
+        transition_table[e] = static_cast<uint32_t>(table[e] < num_states ? table[e] : e / num_encoded_inputs);
+
+    state_output_bits.resize(num_states, 0);
+    for(size_t s = 0; s < num_states; ++s){
+        const auto outputs = fsm.get_state_outputs(s);
+        for(size_t o = 0; o < num_outputs; ++o){
+            if(outputs[o] > 1)
+                throw std::invalid_argument("moore_fsm_bitsliced_bank: every output must be 0 or 1");
+            state_output_bits[s] |= static_cast<uint64_t>(outputs[o]) << o;
+        }
+    }
+
+    state_masks.resize(size_t(1) << num_state_bits);
+    input_masks.resize(num_encoded_inputs);
+    next_state_masks.resize(num_states);
+
+    //Every instance starts from the current state and inputs of the machine
+    state_planes.resize(num_words * num_state_bits, 0);
+    input_planes.resize(num_words * num_inputs, 0);
+    output_planes.resize(num_words * num_outputs, 0);
+    set_all_current_states(fsm.get_current_state_id());
+    const auto& inputs = fsm.get_inputs();
+    for(size_t i = 0; i < num_inputs; ++i)
+        for(size_t w = 0; w < num_words; ++w)
+            input_planes[w * num_inputs + i] = inputs[i] != 0 ? ~uint64_t(0) : 0;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+//Getter/setter of I/O
+int moore_fsm_bitsliced_bank::set_input(const size_t& instance, const size_t& id, const size_t& value){
+    if(instance >= num_instances || id >= num_inputs)
+        return 1;
+    if(value > 1)
+        return 2;
+
+    auto& plane = input_planes[instance / 64 * num_inputs + id];
+    const auto bit = uint64_t(1) << (instance % 64);
+    plane = value != 0 ? plane | bit : plane & ~bit;
+    return 0;
+}
+int moore_fsm_bitsliced_bank::set_input_word(const size_t& word, const size_t& id, const uint64_t& bits){
+    if(word >= num_words || id >= num_inputs)
+        return 1;
+
+    input_planes[word * num_inputs + id] = bits;
+    return 0;
+}
+size_t moore_fsm_bitsliced_bank::get_input(const size_t& instance, const size_t& id) const {
+    if(instance >= num_instances || id >= num_inputs)
+        return -1;
+
+    return (input_planes[instance / 64 * num_inputs + id] >> (instance % 64)) & 1;
+}
+size_t moore_fsm_bitsliced_bank::get_output(const size_t& instance, const size_t& id) const {
+    if(instance >= num_instances || id >= num_outputs)
+        return -1;
+
+    return (output_planes[instance / 64 * num_outputs + id] >> (instance % 64)) & 1;
+}
+uint64_t moore_fsm_bitsliced_bank::get_output_word(const size_t& word, const size_t& id) const {
+    if(word >= num_words || id >= num_outputs)
+        return 0;
+
+    //The channels past the last instance are cleared
+    const auto num_channels = std::min<size_t>(64, num_instances - word * 64);
+    const auto valid_channels = num_channels == 64 ? ~uint64_t(0) : (uint64_t(1) << num_channels) - 1;
+    return output_planes[word * num_outputs + id] & valid_channels;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+//Simulation of the instances
+void moore_fsm_bitsliced_bank::compute_state_masks(const size_t& word){
+    //state_masks[s] gets the channels whose state is s, built one state bit at a time
+    const auto* const planes = state_planes.data() + word * num_state_bits;
+    state_masks[0] = ~uint64_t(0);
+    for(size_t b = 0; b < num_state_bits; ++b){
+        const auto half = size_t(1) << b;
+        for(size_t s = 0; s < half; ++s){
+            state_masks[s + half] = state_masks[s] & planes[b];
+            state_masks[s] &= ~planes[b];
+        }
+    }
+}
+void moore_fsm_bitsliced_bank::update_planes(const size_t& word, const std::vector<uint64_t>& masks){
+    //masks[s] holds the channels in state s: the state and output planes are rebuilt from them
+    for(size_t b = 0; b < num_state_bits; ++b){
+        uint64_t plane = 0;
+        for(size_t s = 0; s < num_states; ++s)
+            plane |= ((s >> b) & 1) != 0 ? masks[s] : 0;
+        state_planes[word * num_state_bits + b] = plane;
+    }
+    for(size_t o = 0; o < num_outputs; ++o){
+        uint64_t plane = 0;
+        for(size_t s = 0; s < num_states; ++s)
+            plane |= ((state_output_bits[s] >> o) & 1) != 0 ? masks[s] : 0;
+        output_planes[word * num_outputs + o] = plane;
+    }
+}
+int moore_fsm_bitsliced_bank::set_current_state(const size_t& instance, const size_t& state_id){
+    if(instance >= num_instances || state_id >= num_states)
+        return 1;
+
+    const auto word = instance / 64;
+    const auto bit = uint64_t(1) << (instance % 64);
+    for(size_t b = 0; b < num_state_bits; ++b){
+        auto& plane = state_planes[word * num_state_bits + b];
+        plane = ((state_id >> b) & 1) != 0 ? plane | bit : plane & ~bit;
+    }
+    for(size_t o = 0; o < num_outputs; ++o){
+        auto& plane = output_planes[word * num_outputs + o];
+        plane = ((state_output_bits[state_id] >> o) & 1) != 0 ? plane | bit : plane & ~bit;
+    }
+    return 0;
+}
+int moore_fsm_bitsliced_bank::set_all_current_states(const size_t& state_id){
+    if(state_id >= num_states)
+        return 1;
+
+    for(size_t w = 0; w < num_words; ++w){
+        for(size_t b = 0; b < num_state_bits; ++b)
+            state_planes[w * num_state_bits + b] = ((state_id >> b) & 1) != 0 ? ~uint64_t(0) : 0;
+        for(size_t o = 0; o < num_outputs; ++o)
+            output_planes[w * num_outputs + o] = ((state_output_bits[state_id] >> o) & 1) != 0 ? ~uint64_t(0) : 0;
+    }
+    return 0;
+}
+size_t moore_fsm_bitsliced_bank::get_current_state_id(const size_t& instance) const {
+    if(instance >= num_instances)
+        return -1;
+
+    size_t state_id = 0;
+    for(size_t b = 0; b < num_state_bits; ++b)
+        state_id |= ((state_planes[instance / 64 * num_state_bits + b] >> (instance % 64)) & 1) << b;
+    return state_id;
+}
+void moore_fsm_bitsliced_bank::step_all(){
+    for(size_t w = 0; w < num_words; ++w){
+        compute_state_masks(w);
+
+        //input_masks[e] gets the channels whose packed inputs are e, built one input at a time
+        const auto* const inputs = input_planes.data() + w * num_inputs;
+        input_masks[0] = ~uint64_t(0);
+        for(size_t i = 0; i < num_inputs; ++i){
+            const auto half = size_t(1) << i;
+            for(size_t e = 0; e < half; ++e){
+                input_masks[e + half] = input_masks[e] & inputs[i];
+                input_masks[e] &= ~inputs[i];
+            }
+        }
+
+        //Every (state, inputs) pair moves its channels to its next state. States without channels are skipped.
+        std::fill(next_state_masks.begin(), next_state_masks.end(), 0);
+        for(size_t s = 0; s < num_states; ++s){
+            if(state_masks[s] == 0)
+                continue;
+
+            const auto* const row = transition_table.data() + s * num_encoded_inputs;
+            for(size_t e = 0; e < num_encoded_inputs; ++e)
+                next_state_masks[row[e]] |= state_masks[s] & input_masks[e];
+        }
+
+        update_planes(w, next_state_masks);
+    }
+}
+void moore_fsm_bitsliced_bank::step_all(const size_t& num_steps){
+    for(size_t i = 0; i < num_steps; ++i)
+        step_all();
+}
+
+
+//==========================================================================================================================================
+//fsm_executor
+//==========================================================================================================================================
+//------------------------------------------------------------------------------------------------------------------------------------------
+//Constructor and destructor
+fsm_executor::fsm_executor(const size_t& num_threads) :
+job_fn(nullptr), job_grain(1), job_generation(0), num_busy_workers(0), stopping(false)
+{
+    //The calling thread also does its share of the work, so one less worker is spawned
+    size_t total_threads = num_threads;
+    if(total_threads == 0)
+        total_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+
+    ranges = std::make_unique<work_range[]>(total_threads);
+    workers.reserve(total_threads - 1);
+    for(size_t i = 1; i < total_threads; ++i)
+        workers.emplace_back(&fsm_executor::worker_loop, this, i);
+}
+fsm_executor::~fsm_executor(){
+    {
+        std::lock_guard<std::mutex> lock(job_mutex);
+        stopping = true;
+    }
+    job_cv.notify_all();
+
+    for(auto& w : workers)
+        w.join();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+//Parallel execution
+void fsm_executor::worker_loop(const size_t& thread_id){
+    size_t seen_generation = 0;
+
+    while(true){
+        {
+            std::unique_lock<std::mutex> lock(job_mutex);
+            job_cv.wait(lock, [&]{return stopping || job_generation != seen_generation;});
+            if(stopping)
+                return;
+            seen_generation = job_generation;
+        }
+
+        work(thread_id);
+
+        {
+            std::lock_guard<std::mutex> lock(job_mutex);
+            if(--num_busy_workers == 0)
+                done_cv.notify_one();
+        }
+    }
+}
+void fsm_executor::work(const size_t& thread_id){
+    const auto num_threads = get_num_threads();
+    const auto outer_executor = running_executor;
+    running_executor = this;
+
+    //Start from the own range, then steal from the ranges of the other threads
+    for(size_t k = 0; k < num_threads; ++k){
+        auto& range = ranges[(thread_id + k) % num_threads];
+
+        while(true){
+            const auto begin = range.next.fetch_add(job_grain, std::memory_order_relaxed);
+            if(begin >= range.end)
+                break;
+
+            const auto end = std::min(begin + job_grain, range.end);
+            try {
+                for(size_t i = begin; i < end; ++i)
+                    (*job_fn)(i);
+            } catch(...) {
+                std::lock_guard<std::mutex> lock(job_mutex);
+                if(!job_exception)
+                    job_exception = std::current_exception();
+            }
+        }
+    }
+
+    running_executor = outer_executor;
+}
+void fsm_executor::parallel_for(const size_t& count, const std::function<void(size_t)>& fn, const size_t& grain){
+    if(count == 0)
+        return;
+
+    //A job calling back into its own executor would wait forever for the threads it's running on
+    if(running_executor == this)
+        throw std::logic_error("fsm_executor::parallel_for: nested call from a job of the same executor");
+
+    std::lock_guard<std::mutex> call_lock(call_mutex);
+    const auto num_threads = get_num_threads();
+
+    //Split the work into one contiguous range per thread
+    for(size_t t = 0; t < num_threads; ++t){
+        ranges[t].next.store(count * t / num_threads, std::memory_order_relaxed);
+        ranges[t].end = count * (t + 1) / num_threads;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(job_mutex);
+        job_fn = &fn;
+        job_grain = std::max<size_t>(1, grain);
+        job_exception = nullptr;
+        num_busy_workers = workers.size();
+        ++job_generation;
+    }
+    job_cv.notify_all();
+
+    work(0);
+
+    std::exception_ptr exception;
+    {
+        std::unique_lock<std::mutex> lock(job_mutex);
+        done_cv.wait(lock, [&]{return num_busy_workers == 0;});
+        exception = job_exception;
+        job_fn = nullptr;
+    }
+
+    if(exception)
+        std::rethrow_exception(exception);
+}
+void fsm_executor::step_machines(std::span<moore_fsm> machines, const size_t& num_steps){
+    parallel_for(machines.size(), [&](const size_t& i){
+        machines[i].step_machine(num_steps);
+    });
+}
+int fsm_executor::run_machines(std::span<moore_fsm> machines, std::span<const std::span<const size_t>> input_traces){
+    if(machines.size() != input_traces.size())
+        return 1;
+
+    parallel_for(machines.size(), [&](const size_t& i){
+        machines[i].run(input_traces[i], {}, trace_mode::final_state);
+    });
+    return 0;
+}
+int fsm_executor::run_traces(const moore_fsm& fsm, std::span<const std::span<const size_t>> input_traces, std::span<size_t> final_states){
+    if(final_states.size() < input_traces.size())
+        return 1;
+
+    //Every trace starts from the current state of the machine, which is only read, never modified
+    const auto num_inputs = fsm.get_num_inputs();
+    const auto initial_state_id = fsm.get_current_state_id();
+    parallel_for(input_traces.size(), [&](const size_t& i){
+        std::vector<size_t> scratch_inputs;
+        const auto& trace = input_traces[i];
+        size_t state_id = initial_state_id;
+
+        if(num_inputs == 0 || trace.size() % num_inputs != 0){
+            final_states[i] = -1;
+            return;
+        }
+
+        for(size_t k = 0; k < trace.size(); k += num_inputs){
+            const auto next_state_id = fsm.get_next_state(state_id, trace.subspan(k, num_inputs), scratch_inputs);
+            if(next_state_id < fsm.get_num_states())
+                state_id = next_state_id;
+        }
+        final_states[i] = state_id;
+    });
+    return 0;
+}
+
+
+//==========================================================================================================================================
+//mapped_moore_fsm
+//==========================================================================================================================================
+//------------------------------------------------------------------------------------------------------------------------------------------
+//Name tables
+std::string_view mapped_moore_fsm::name_table_view::get_name(const size_t& id) const {
+    if(id >= num_ids)
+        return {};
+
+    const auto offset = id_index[2 * id];
+    const auto length = id_index[2 * id + 1];
+    if(offset > chars_size || length > chars_size - offset)
+        return {};
+
+    return std::string_view(chars + offset, length);
+}
+std::string_view mapped_moore_fsm::name_table_view::get_sorted_name(const size_t& i) const {
+    const auto offset = sorted_index[3 * i];
+    const auto length = sorted_index[3 * i + 1];
+    if(offset > chars_size || length > chars_size - offset)
+        return {};
+
+    return std::string_view(chars + offset, length);
+}
+size_t mapped_moore_fsm::name_table_view::get_id(std::string_view name) const {
+    //Binary search over the sorted names
+    size_t low = 0;
+    size_t high = num_names;
+    while(low < high){
+        const auto mid = low + (high - low) / 2;
+        if(get_sorted_name(mid) < name)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    if(low < num_names && get_sorted_name(low) == name)
+        return sorted_index[3 * low + 2];
+    else
+        return -1;
+}
+int mapped_moore_fsm::parse_name_table(const std::byte* section, const size_t& section_size, const uint64_t& num_ids, name_table_view& view){
+    if(section_size < 3 * sizeof(uint64_t))
+        return 1;
+
+    const auto values = reinterpret_cast<const uint64_t*>(section);
+    view.num_ids = values[0];
+    view.num_names = values[1];
+    view.chars_size = values[2];
+
+    //The table names exactly the ids of the machine
+    const auto max_values = section_size / sizeof(uint64_t);
+    if(view.num_ids != num_ids || view.num_ids > max_values || view.num_names > max_values)
+        return 1;
+    const auto index_size = (3 + 2 * view.num_ids + 3 * view.num_names) * sizeof(uint64_t);
+    if(index_size > section_size || view.chars_size > section_size - index_size)
+        return 1;
+
+    view.id_index = values + 3;
+    view.sorted_index = view.id_index + 2 * view.num_ids;
+    view.chars = reinterpret_cast<const char*>(section + index_size);
+
+    //Every name must lie inside the characters, and the sorted names must be sorted, unique and name valid ids,
+    //since they are searched and loaded into the symbol tables without further checks
+    const auto in_chars = [&](const uint64_t& offset, const uint64_t& length){return offset <= view.chars_size && length <= view.chars_size - offset;};
+    for(size_t id = 0; id < view.num_ids; ++id)
+        if(!in_chars(view.id_index[2 * id], view.id_index[2 * id + 1]))
+            return 1;
+    for(size_t i = 0; i < view.num_names; ++i){
+        if(!in_chars(view.sorted_index[3 * i], view.sorted_index[3 * i + 1]) || view.sorted_index[3 * i + 2] >= view.num_ids)
+            return 1;
+        if(i != 0 && !(view.get_sorted_name(i - 1) < view.get_sorted_name(i)))
+            return 1;
+    }
+    return 0;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+//Constructors and destructor
+mapped_moore_fsm::mapped_moore_fsm() :
+data(nullptr), data_size(0), num_inputs(0), num_outputs(0), num_states(0), num_encoded_inputs(0), initial_state_id(0),
+input_alphabet_sizes(nullptr), state_outputs(nullptr), transition_table(nullptr), input_names{}, output_names{}, state_names{}
+{}
+mapped_moore_fsm::~mapped_moore_fsm(){
+    close();
+}
+mapped_moore_fsm::mapped_moore_fsm(mapped_moore_fsm&& other) noexcept :
+mapped_moore_fsm()
+{
+    *this = std::move(other);
+}
+mapped_moore_fsm& mapped_moore_fsm::operator=(mapped_moore_fsm&& other) noexcept {
+    if(this != &other){
+        close();
+
+        //All the members are views into the mapping, which now belongs to this object
+        data = other.data;
+        data_size = other.data_size;
+        num_inputs = other.num_inputs;
+        num_outputs = other.num_outputs;
+        num_states = other.num_states;
+        num_encoded_inputs = other.num_encoded_inputs;
+        initial_state_id = other.initial_state_id;
+        input_alphabet_sizes = other.input_alphabet_sizes;
+        state_outputs = other.state_outputs;
+        transition_table = other.transition_table;
+        input_names = other.input_names;
+        output_names = other.output_names;
+        state_names = other.state_names;
+
+        other.data = nullptr;
+        other.close();
+    }
+    return *this;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+//Opening and closing the file
+int mapped_moore_fsm::open(const std::string& path){
+    close();
+
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        return 1;
+
+    struct stat file_stat;
+    if(fstat(fd, &file_stat) != 0 || static_cast<size_t>(file_stat.st_size) < sizeof(binary_header)){
+        ::close(fd);
+        return 2;
+    }
+
+    const auto size = static_cast<size_t>(file_stat.st_size);
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(mapping == MAP_FAILED)
+        return 1;
+
+    data = static_cast<const std::byte*>(mapping);
+    data_size = size;
+
+    //Check the header and the bounds and the alignment of every section, since they are read in place
+    binary_header header;
+    std::memcpy(&header, data, sizeof(header));
+    const auto fits = [&](const uint64_t& offset, const uint64_t& count) -> bool{
+        return offset % 8 == 0 && offset <= data_size && count <= (data_size - offset) / sizeof(uint64_t);
+    };
+    const bool valid = std::memcmp(header.magic, binary_magic, sizeof(binary_magic)) == 0 &&
+                       header.version == binary_version &&
+                       header.file_size == data_size &&
+                       header.initial_state_id < std::max<uint64_t>(header.num_states, 1) &&
+                       fits(header.alphabet_offset, header.num_inputs) &&
+                       (header.num_outputs == 0 || header.num_states <= data_size / header.num_outputs) &&
+                       fits(header.outputs_offset, header.num_states * header.num_outputs) &&
+                       (header.num_encoded_inputs == 0 || header.num_states <= data_size / header.num_encoded_inputs) &&
+                       fits(header.table_offset, header.num_states * header.num_encoded_inputs) &&
+                       header.input_names_offset % 8 == 0 && header.output_names_offset % 8 == 0 && header.state_names_offset % 8 == 0 &&
+                       header.input_names_offset <= header.output_names_offset &&
+                       header.output_names_offset <= header.state_names_offset &&
+                       header.state_names_offset <= data_size &&
+                       parse_name_table(data + header.input_names_offset, header.output_names_offset - header.input_names_offset, header.num_inputs, input_names) == 0 &&
+                       parse_name_table(data + header.output_names_offset, header.state_names_offset - header.output_names_offset, header.num_outputs, output_names) == 0 &&
+                       parse_name_table(data + header.state_names_offset, data_size - header.state_names_offset, header.num_states, state_names) == 0;
+    if(!valid){
+        close();
+        return 2;
+    }
+
+    num_inputs = header.num_inputs;
+    num_outputs = header.num_outputs;
+    num_states = header.num_states;
+    num_encoded_inputs = header.num_encoded_inputs;
+    initial_state_id = header.initial_state_id;
+    input_alphabet_sizes = reinterpret_cast<const uint64_t*>(data + header.alphabet_offset);
+    state_outputs = reinterpret_cast<const uint64_t*>(data + header.outputs_offset);
+    transition_table = reinterpret_cast<const uint64_t*>(data + header.table_offset);
+    return 0;
+}
+void mapped_moore_fsm::close(){
+    if(data != nullptr)
+        munmap(const_cast<std::byte*>(data), data_size);
+
+    data = nullptr;
+    data_size = 0;
+    num_inputs = num_outputs = num_states = num_encoded_inputs = initial_state_id = 0;
+    input_alphabet_sizes = state_outputs = transition_table = nullptr;
+    input_names = output_names = state_names = name_table_view{};
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+//Getters of general machine info
+size_t mapped_moore_fsm::get_input_alphabet_size(const size_t& input_id) const {
+    if(input_id >= num_inputs)
+        return 0;
+
+    return input_alphabet_sizes[input_id];
+}
+size_t mapped_moore_fsm::encode_inputs(std::span<const size_t> in) const {
+    if(in.size() != num_inputs)
+        return -1;
+
+    size_t encoded = 0;
+    size_t stride = 1;
+    for(size_t i = 0; i < num_inputs; ++i){
+        if(in[i] >= input_alphabet_sizes[i])
+            return -1;
+        encoded += in[i] * stride;
+        stride *= input_alphabet_sizes[i];
+    }
+
+    return encoded;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+//Transitions and outputs
+size_t mapped_moore_fsm::get_next_state(const size_t& state_id, const size_t& encoded_inputs) const {
+    if(state_id >= num_states || encoded_inputs >= num_encoded_inputs)
+        return -1;
+
+    //The table isn't validated when the file is opened, so the entry is checked here
+    const auto next_state_id = transition_table[state_id * num_encoded_inputs + encoded_inputs];
+    return next_state_id < num_states ? next_state_id : static_cast<size_t>(-1);
+}
+std::span<const uint64_t> mapped_moore_fsm::get_state_outputs(const size_t& state_id) const {
+    if(state_id >= num_states)
+        return {};
+
+    return {state_outputs + state_id * num_outputs, num_outputs};
+}
+moore_fsm mapped_moore_fsm::to_moore_fsm() const {
+    std::vector<size_t> alphabet_sizes(input_alphabet_sizes, input_alphabet_sizes + num_inputs);
+    std::vector<size_t> outputs(state_outputs, state_outputs + num_states * num_outputs);
+    std::vector<size_t> table(transition_table, transition_table + num_states * num_encoded_inputs);
+    auto fsm = moore_fsm::from_transition_table(alphabet_sizes, num_outputs, outputs, std::move(table));
+
+    //Main names first, then the aliases
+    const auto load_names = [](const name_table_view& view, symbol_table& names){
+        names.clear();
+        names.reserve(view.num_ids);
+        for(size_t id = 0; id < view.num_ids; ++id)
+            if(!view.get_name(id).empty())
+                names.set_name(id, std::string(view.get_name(id)));
+        for(size_t i = 0; i < view.num_names; ++i){
+            const auto name = view.get_sorted_name(i);
+            if(!names.contains(name))
+                names.add_alias(view.sorted_index[3 * i + 2], std::string(name));
+        }
+    };
+    load_names(input_names, fsm.name_input_id_map);
+    load_names(output_names, fsm.name_output_id_map);
+    load_names(state_names, fsm.name_state_id_map);
+
+    if(num_states != 0)
+        fsm.set_current_state(initial_state_id);
+    return fsm;
+}
+
+
+//==========================================================================================================================================
+//transition_recorder
+//==========================================================================================================================================
+//------------------------------------------------------------------------------------------------------------------------------------------
+//Constructor
+transition_recorder::transition_recorder(const size_t& _capacity, const size_t& _num_inputs, const std::string& _error_dump_path) :
+capacity(_capacity), num_inputs(_num_inputs), record_size(3 + _num_inputs), num_recorded(0), error_dump_path(_error_dump_path), error_dumped(false)
+{
+    if(capacity == 0)
+        throw std::invalid_argument("transition_recorder: the capacity must be at least 1");
+
+    records = std::make_unique<std::atomic<uint64_t>[]>(capacity * record_size);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+//Recording and reading the transitions
+void transition_recorder::record(const size_t& from_state_id, const size_t& to_state_id, std::span<const size_t> inputs){
+    //Single writer. The step word of the slot works as a sequence lock: it is invalidated before the other words are
+    //overwritten and set to the step once they are complete, so readers can detect the records changed while they were copied.
+    //Relaxed atomic stores compile to plain stores, so recording costs a few more than record_size stores.
+    const auto step = num_recorded.load(std::memory_order_relaxed);
+    auto* const slot = records.get() + (step % capacity) * record_size;
+    slot[0].store(-1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot[1].store(from_state_id, std::memory_order_relaxed);
+    slot[2].store(to_state_id, std::memory_order_relaxed);
+    for(size_t i = 0; i < num_inputs; ++i)
+        slot[3 + i].store(i < inputs.size() ? inputs[i] : 0, std::memory_order_relaxed);
+    slot[0].store(step, std::memory_order_release);
+    num_recorded.store(step + 1, std::memory_order_release);
+
+    //Only the first invalid transition of a burst is dumped, so a machine stuck on invalid inputs isn't slowed down by a dump per step
+    if(to_state_id != static_cast<size_t>(-1))
+        error_dumped = false;
+    else if(!error_dumped && !error_dump_path.empty()){
+        dump(error_dump_path);
+        error_dumped = true;
+    }
+}
+size_t transition_recorder::get_records(std::vector<uint64_t>& out) const {
+    const auto end = num_recorded.load(std::memory_order_acquire);
+    const auto begin = end > capacity ? end - capacity : 0;
+
+    out.resize((end - begin) * record_size);
+    size_t num_records = 0;
+    for(auto step = begin; step < end; ++step){
+        const auto* const slot = records.get() + (step % capacity) * record_size;
+        auto* const copy = out.data() + num_records * record_size;
+        if(slot[0].load(std::memory_order_acquire) != step)
+            continue;
+        for(size_t w = 0; w < record_size; ++w)
+            copy[w] = slot[w].load(std::memory_order_relaxed);
+
+        //The writer may have overwritten the oldest records while they were copied: those are dropped
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(slot[0].load(std::memory_order_relaxed) == step)
+            ++num_records;
+    }
+
+    out.resize(num_records * record_size);
+    return num_records;
+}
+int transition_recorder::dump(const std::string& path) const {
+    std::vector<uint64_t> out;
+    const auto num_records = get_records(out);
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if(!file)
+        return 1;
+
+    recorder_header header;
+    std::memcpy(header.magic, recorder_magic, sizeof(header.magic));
+    header.version = recorder_version;
+    header.record_size = record_size;
+    header.num_inputs = num_inputs;
+    header.num_records = num_records;
+    header.num_recorded = num_recorded.load(std::memory_order_acquire);
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(out.data()), out.size() * sizeof(uint64_t));
+    return file ? 0 : 1;
+}
+void transition_recorder::clear(){
+    num_recorded.store(0, std::memory_order_release);
+    error_dumped = false;
+}
+
+
+//==========================================================================================================================================
+//transition_profiler
+//==========================================================================================================================================
+//Counters of a single machine. The visits are written without locks by the machine, as relaxed atomics, and read by everyone else;
+//the mutex protects the array of the visits when it grows, the sampled counters and the cleared visits.
+//Only the machine writes the visits: clear() doesn't reset them, which would race with the machine, but saves them in cleared_visits,
+//and they are subtracted when read.
+struct transition_profiler::shard {
+    std::mutex mutex;
+    std::unique_ptr<std::atomic<uint64_t>[]> state_visits;
+    size_t num_states = 0;
+    std::vector<uint64_t> cleared_visits;
+    std::map<std::pair<size_t, size_t>, uint64_t> edge_counts;
+    std::vector<uint64_t> fn_calls;
+    std::vector<uint64_t> fn_nanoseconds;
+};
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+//Constructor and destructor
+transition_profiler::transition_profiler(const size_t& _sampling_period) :
+sampling_period(std::max<size_t>(1, _sampling_period))
+{}
+transition_profiler::~transition_profiler() = default;
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+//Counting, used by the attached machines
+transition_profiler::shard* transition_profiler::add_shard(shard* reused){
+    //A machine attaching again to the same profiler keeps counting into its shard, instead of leaving one behind at every attach
+    std::lock_guard<std::mutex> lock(shards_mutex);
+    for(const auto& s : shards)
+        if(s.get() == reused)
+            return reused;
+    shards.push_back(std::make_unique<shard>());
+    return shards.back().get();
+}
+void transition_profiler::grow_state_visits(shard& s, const size_t& num_states){
+    //Only the machine that owns the shard grows it, so the counts can be copied before taking the lock
+    const auto new_num_states = std::max(num_states, 2 * s.num_states);
+    auto new_visits = std::make_unique<std::atomic<uint64_t>[]>(new_num_states);
+    for(size_t i = 0; i < s.num_states; ++i)
+        new_visits[i].store(s.state_visits[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.state_visits = std::move(new_visits);
+    s.num_states = new_num_states;
+}
+void transition_profiler::count_visit(shard& s, const size_t& state_id){
+    if(state_id >= s.num_states)
+        grow_state_visits(s, state_id + 1);
+
+    //Single writer: a load and a store instead of an atomic increment
+    auto& visits = s.state_visits[state_id];
+    visits.store(visits.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+void transition_profiler::count_sample(shard& s, const size_t& from_state_id, const size_t& to_state_id, const bool& timed, const uint64_t& nanoseconds){
+    std::lock_guard<std::mutex> lock(s.mutex);
+    ++s.edge_counts[{from_state_id, to_state_id}];
+
+    if(timed){
+        if(from_state_id >= s.fn_calls.size()){
+            s.fn_calls.resize(from_state_id + 1, 0);
+            s.fn_nanoseconds.resize(from_state_id + 1, 0);
+        }
+        ++s.fn_calls[from_state_id];
+        s.fn_nanoseconds[from_state_id] += nanoseconds;
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+//Reading the counts
+std::vector<uint64_t> transition_profiler::get_state_visits() const {
+    std::vector<uint64_t> visits;
+    std::lock_guard<std::mutex> lock(shards_mutex);
+    for(const auto& s : shards){
+        std::lock_guard<std::mutex> shard_lock(s->mutex);
+        if(visits.size() < s->num_states)
+            visits.resize(s->num_states, 0);
+        for(size_t i = 0; i < s->num_states; ++i)
+            visits[i] += s->state_visits[i].load(std::memory_order_relaxed) - (i < s->cleared_visits.size() ? s->cleared_visits[i] : 0);
+    }
+
+    //The arrays grow in steps, trailing states that were never visited are dropped
+    while(!visits.empty() && visits.back() == 0)
+        visits.pop_back();
+    return visits;
+}
+std::vector<transition_profiler::edge_count> transition_profiler::get_edge_counts() const {
+    std::map<std::pair<size_t, size_t>, uint64_t> merged;
+    {
+        std::lock_guard<std::mutex> lock(shards_mutex);
+        for(const auto& s : shards){
+            std::lock_guard<std::mutex> shard_lock(s->mutex);
+            for(const auto& [edge, count] : s->edge_counts)
+                merged[edge] += count;
+        }
+    }
+
+    std::vector<edge_count> edges;
+    edges.reserve(merged.size());
+    for(const auto& [edge, count] : merged)
+        edges.push_back({edge.first, edge.second, count});
+    return edges;
+}
+std::vector<transition_profiler::transition_fn_time> transition_profiler::get_transition_fn_times() const {
+    std::vector<uint64_t> calls, nanoseconds;
+    {
+        std::lock_guard<std::mutex> lock(shards_mutex);
+        for(const auto& s : shards){
+            std::lock_guard<std::mutex> shard_lock(s->mutex);
+            if(calls.size() < s->fn_calls.size()){
+                calls.resize(s->fn_calls.size(), 0);
+                nanoseconds.resize(s->fn_calls.size(), 0);
+            }
+            for(size_t i = 0; i < s->fn_calls.size(); ++i){
+                calls[i] += s->fn_calls[i];
+                nanoseconds[i] += s->fn_nanoseconds[i];
+            }
+        }
+    }
+
+    std::vector<transition_fn_time> times;
+    for(size_t i = 0; i < calls.size(); ++i)
+        if(calls[i] != 0)
+            times.push_back({i, calls[i], nanoseconds[i]});
+    return times;
+}
+int transition_profiler::export_csv(const std::string& path) const {
+    std::ofstream file(path, std::ios::trunc);
+    if(!file)
+        return 1;
+
+    //One row per counter: kind, from (or state) id, to id, count, nanoseconds
+    file << "kind,state_id,to_state_id,count,nanoseconds\n";
+    const auto visits = get_state_visits();
+    for(size_t i = 0; i < visits.size(); ++i)
+        if(visits[i] != 0)
+            file << "visits," << i << ",," << visits[i] << ",\n";
+    for(const auto& e : get_edge_counts()){
+        file << "edge," << e.from_state_id << ",";
+        if(e.to_state_id != static_cast<size_t>(-1))
+            file << e.to_state_id;
+        file << "," << e.count << ",\n";
+    }
+    for(const auto& t : get_transition_fn_times())
+        file << "transition_fn," << t.state_id << ",," << t.calls << "," << t.nanoseconds << "\n";
+
+    return file ? 0 : 1;
+}
+void transition_profiler::clear(){
+    std::lock_guard<std::mutex> lock(shards_mutex);
+    for(const auto& s : shards){
+        std::lock_guard<std::mutex> shard_lock(s->mutex);
+        s->cleared_visits.resize(s->num_states);
+        for(size_t i = 0; i < s->num_states; ++i)
+            s->cleared_visits[i] = s->state_visits[i].load(std::memory_order_relaxed);
+        s->edge_counts.clear();
+        s->fn_calls.assign(s->fn_calls.size(), 0);
+        s->fn_nanoseconds.assign(s->fn_nanoseconds.size(), 0);
+    }
+}
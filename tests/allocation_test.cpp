@@ -0,0 +1,115 @@
+/*
+Checks that stepping in steady state does no heap allocations: every allocation of the program is counted by replacing the
+global operator new, and the machines are stepped with the counter on after a few warm up steps.
+*/
+
+#include <atomic>
+#include <vector>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include "fsmlib.hpp"
+#include "check.hpp"
+
+using namespace std;
+
+//Counting allocator: every allocation made by the program goes through here
+static atomic<size_t> num_allocations{0};
+
+void* operator new(size_t size){
+    num_allocations.fetch_add(1, memory_order_relaxed);
+    if(void* p = malloc(size == 0 ? 1 : size))
+        return p;
+    throw bad_alloc();
+}
+void operator delete(void* p) noexcept {free(p);}
+void operator delete(void* p, size_t) noexcept {free(p);}
+
+//Every check adds its results here, so that the compiler can't drop the stepping
+static volatile size_t sink;
+
+//Next state of the test machines: a fixed pseudo random graph over 4 boolean inputs
+static size_t next_of(const size_t& state_id, const size_t& encoded_inputs, const size_t& num_states){
+    return (state_id * 2654435761u + encoded_inputs * 40503u + 7) % num_states;
+}
+
+//Machine whose transition functions use ids, as state_transition_fn or as handle_transition_fn
+static moore_fsm make_machine(const size_t& num_states, const bool& handles){
+    moore_fsm fsm{4, 1, num_states};
+    for(size_t i = 0; i < 4; ++i)
+        fsm.set_input_alphabet_size(i, 2);
+
+    for(size_t s = 0; s < num_states; ++s){
+        if(handles)
+            fsm.add_state({s & 1}, [=](input_view inputs) -> size_t{
+                return next_of(s, inputs[0] | inputs[1] << 1 | inputs[2] << 2 | inputs[3] << 3, num_states);
+            });
+        else
+            fsm.add_state({s & 1}, [=]tr_lamba -> size_t{
+                return next_of(s, inputs[0] | inputs[1] << 1 | inputs[2] << 2 | inputs[3] << 3, num_states);
+            });
+    }
+
+    fsm.set_current_state(0);
+    return fsm;
+}
+
+//Number of allocations of 100000 steps with random inputs, after some warm up steps that let lazily grown buffers be allocated
+static size_t count_allocations(const function<void(const vector<size_t>&)>& step){
+    uint64_t rng = 88172645463325252ull;
+    vector<size_t> in(4);
+    const auto random_step = [&]{
+        for(auto& i : in){
+            rng ^= rng << 13;
+            rng ^= rng >> 7;
+            rng ^= rng << 17;
+            i = rng & 1;
+        }
+        step(in);
+    };
+
+    for(size_t k = 0; k < 16; ++k)
+        random_step();
+
+    const auto allocations_before = num_allocations.load();
+    for(size_t k = 0; k < 100000; ++k)
+        random_step();
+    return num_allocations.load() - allocations_before;
+}
+
+int main(){
+    for(const bool handles : {false, true}){
+        auto fsm = make_machine(1024, handles);
+        CHECK(count_allocations([&](const vector<size_t>& in){
+            fsm.set_inputs(in);
+            sink = fsm.step_machine();
+            sink = fsm.get_outputs()[0] + fsm.get_output(0);
+        }) == 0);
+    }
+
+    auto fsm = make_machine(1024, false);
+    CHECK(fsm.compile() == 0);
+    CHECK(count_allocations([&](const vector<size_t>& in){
+        fsm.set_inputs(in);
+        sink = fsm.step_machine();
+        sink = fsm.get_outputs()[0] + fsm.get_output(0);
+    }) == 0);
+
+    vector<size_t> output_trace(64);
+    vector<size_t> trace(64 * 4, 1);
+    CHECK(count_allocations([&](const vector<size_t>& in){
+        trace[0] = in[0];
+        sink = fsm.run(trace, output_trace, trace_mode::outputs);
+    }) == 0);
+
+    moore_fsm_bank bank(fsm, 64);
+    CHECK(count_allocations([&](const vector<size_t>& in){
+        bank.set_inputs(in[0], in);
+        bank.step_all();
+        sink = bank.get_output(0, 0);
+    }) == 0);
+
+    if(num_failures == 0)
+        cout << "allocation_test: ok" << endl;
+    return num_failures;
+}
@@ -0,0 +1,109 @@
+/*
+Checks that every instance of a moore_fsm_bank steps exactly like its own moore_fsm, with different inputs per instance
+and invalid transitions, and that a bank can't be built from a machine without a current state.
+*/
+
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <stdexcept>
+#include "fsmlib.hpp"
+#include "check.hpp"
+
+using namespace std;
+
+//Random tabulated machine with inputs of alphabet sizes 2 and 3, one transition in fifteen invalid
+static moore_fsm make_machine(const size_t& num_states, mt19937_64& rng){
+    vector<size_t> table(num_states * 6);
+    for(auto& next_state_id : table)
+        next_state_id = rng() % 15 == 0 ? static_cast<size_t>(-1) : rng() % num_states;
+
+    vector<size_t> outputs(num_states * 2);
+    for(size_t s = 0; s < num_states; ++s){
+        outputs[2 * s] = s;
+        outputs[2 * s + 1] = rng() % 5;
+    }
+
+    auto fsm = moore_fsm::from_transition_table({2, 3}, 2, outputs, table);
+    fsm.set_current_state(rng() % num_states);
+    return fsm;
+}
+
+int main(){
+    mt19937_64 rng(3);
+
+    for(const size_t num_states : {1, 6, 100}){
+        auto fsm = make_machine(num_states, rng);
+        fsm.set_inputs({1, 2});
+
+        //Every instance has its own reference machine, starting from the state and inputs of fsm
+        const size_t num_instances = 37;
+        moore_fsm_bank bank(fsm, num_instances);
+        vector<moore_fsm> references(num_instances, fsm);
+        CHECK(bank.get_num_instances() == num_instances);
+        for(size_t i = 0; i < num_instances; ++i){
+            CHECK(bank.get_current_state_id(i) == fsm.get_current_state_id());
+            CHECK(ranges::equal(bank.get_outputs(i), fsm.get_outputs()));
+        }
+
+        for(size_t k = 0; k < 300; ++k){
+            //Inputs change on a random subset of the instances, set by id or all at once
+            for(size_t i = 0; i < num_instances; ++i){
+                if(rng() % 3 == 0){
+                    const vector<size_t> inputs = {rng() % 2, rng() % 3};
+                    CHECK(bank.set_inputs(i, inputs) == 0);
+                    references[i].set_inputs(inputs);
+                } else if(rng() % 3 == 0){
+                    const auto value = rng() % 3;
+                    CHECK(bank.set_input(i, 1, value) == 0);
+                    references[i].set_input(1, value);
+                }
+            }
+
+            if(k % 10 == 9){
+                bank.step_all(3);
+                for(auto& reference : references)
+                    reference.step_machine(3);
+            } else {
+                bank.step_all();
+                for(auto& reference : references)
+                    reference.step_machine();
+            }
+
+            for(size_t i = 0; i < num_instances; ++i){
+                CHECK(bank.get_current_state_id(i) == references[i].get_current_state_id());
+                CHECK(ranges::equal(bank.get_outputs(i), references[i].get_outputs()));
+                CHECK(bank.get_output(i, 1) == references[i].get_outputs()[1]);
+            }
+        }
+
+        //Values outside of the alphabets and instances out of range are rejected
+        CHECK(bank.set_input(0, 0, 2) != 0);
+        CHECK(bank.set_input(num_instances, 0, 0) != 0);
+        CHECK(bank.set_current_state(0, num_states) != 0);
+    }
+
+    //The machine must be compiled and have a current state
+    const auto throws = [](const moore_fsm& fsm){
+        try {
+            moore_fsm_bank bank(fsm, 4);
+        } catch(const invalid_argument&) {
+            return true;
+        }
+        return false;
+    };
+    auto fsm = make_machine(8, rng);
+    CHECK(!throws(fsm));
+    auto uncompiled = fsm;
+    uncompiled.set_input_alphabet_size(0, 2);
+    CHECK(!uncompiled.is_compiled());
+    CHECK(throws(uncompiled));
+    vector<size_t> old_to_new_state_id;
+    CHECK(fsm.remove_state(fsm.get_current_state_id(), old_to_new_state_id) == 0);
+    CHECK(fsm.is_compiled());
+    CHECK(throws(fsm));
+
+    if(num_failures == 0)
+        cout << "bank_test: ok" << endl;
+    return num_failures;
+}
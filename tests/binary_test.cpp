@@ -0,0 +1,135 @@
+/*
+Checks the binary files of the machines: save_binary -> mapped_moore_fsm -> to_moore_fsm gives back exactly the same machine,
+names and aliases included, and corrupt files are rejected by mapped_moore_fsm::open.
+*/
+
+#include <vector>
+#include <string>
+#include <random>
+#include <fstream>
+#include <cstring>
+#include <filesystem>
+#include "fsmlib.hpp"
+#include "check.hpp"
+
+using namespace std;
+
+static vector<char> read_file(const string& path){
+    ifstream file(path, ios::binary);
+    return vector<char>(istreambuf_iterator<char>(file), {});
+}
+static void write_file(const string& path, const vector<char>& bytes){
+    ofstream(path, ios::binary).write(bytes.data(), bytes.size());
+}
+static uint64_t get_word(const vector<char>& bytes, const size_t& offset){
+    uint64_t word;
+    memcpy(&word, bytes.data() + offset, sizeof(word));
+    return word;
+}
+static void set_word(vector<char>& bytes, const size_t& offset, const uint64_t& word){
+    memcpy(bytes.data() + offset, &word, sizeof(word));
+}
+
+int main(){
+    const auto directory = filesystem::temp_directory_path();
+    const auto path = (directory / "fsmlib_binary_test.bin").string();
+    const auto corrupt_path = (directory / "fsmlib_binary_test_corrupt.bin").string();
+    mt19937_64 rng(12);
+
+    //Machine with two inputs, where states s and s + 15 are equivalent: minimizing it keeps the names of the merged states as aliases
+    const size_t num_states = 30, num_encoded_inputs = 6;
+    vector<size_t> table(num_states * num_encoded_inputs), outputs(num_states * 2);
+    for(size_t s = 0; s < 15; ++s)
+        for(size_t e = 0; e < num_encoded_inputs; ++e)
+            table[s * num_encoded_inputs + e] = table[(s + 15) * num_encoded_inputs + e] = rng() % 10 == 0 ? static_cast<size_t>(-1) : rng() % num_states;
+    for(size_t s = 0; s < num_states; ++s){
+        outputs[2 * s] = s % 15;
+        outputs[2 * s + 1] = (s % 15) * 1000;
+    }
+    auto original = moore_fsm::from_transition_table({2, 3}, 2, outputs, table);
+    original.set_input_name(0, "enable");
+    original.set_input_name(1, "mode");
+    original.set_output_name(1, "scaled");
+    for(size_t s = 0; s < num_states; ++s)
+        original.set_state_name(s, "state_" + to_string(s));
+    original.set_current_state(20);
+    original.compile();
+
+    moore_fsm fsm(2, 2);
+    vector<size_t> old_to_new_state_id;
+    CHECK(original.minimize(fsm, old_to_new_state_id) == 0);
+    CHECK(fsm.get_num_states() == 15);
+    CHECK(fsm.get_state_id("state_20") == fsm.get_state_id("state_5"));
+    CHECK(fsm.save_binary(path) == 0);
+
+    //The mapped machine reads the same sizes, table, outputs and names
+    mapped_moore_fsm mapped;
+    CHECK(mapped.open(path) == 0);
+    CHECK(mapped.get_num_inputs() == 2 && mapped.get_num_outputs() == 2 && mapped.get_num_states() == fsm.get_num_states());
+    CHECK(mapped.get_initial_state_id() == fsm.get_current_state_id());
+    CHECK(ranges::equal(mapped.get_transition_table(), fsm.get_transition_table()));
+    for(size_t s = 0; s < fsm.get_num_states(); ++s){
+        CHECK(ranges::equal(mapped.get_state_outputs(s), fsm.get_state_outputs(s)));
+        CHECK(mapped.get_state_name(s) == fsm.get_state_name(s));
+    }
+    for(size_t s = 0; s < num_states; ++s)
+        CHECK(mapped.get_state_id("state_" + to_string(s)) == fsm.get_state_id("state_" + to_string(s)));
+    CHECK(mapped.get_input_id("mode") == 1 && mapped.get_output_name(1) == "scaled");
+    CHECK(mapped.get_state_id("missing") == static_cast<size_t>(-1));
+
+    //The machine loaded back steps like the saved one
+    auto loaded = mapped.to_moore_fsm();
+    CHECK(loaded.is_compiled());
+    CHECK(loaded.get_transition_table() == fsm.get_transition_table());
+    CHECK(loaded.get_current_state_id() == fsm.get_current_state_id());
+    for(size_t s = 0; s < num_states; ++s)
+        CHECK(loaded.get_state_id("state_" + to_string(s)) == fsm.get_state_id("state_" + to_string(s)));
+    for(size_t k = 0; k < 2000; ++k){
+        const size_t enable = rng() % 2, mode = rng() % 3;
+        fsm.set_inputs({enable, mode});
+        loaded.set_inputs({enable, mode});
+        const auto state_id = fsm.get_current_state_id();
+        const auto next_state_id = fsm.step_machine();
+        CHECK(loaded.step_machine() == next_state_id);
+        CHECK(mapped.get_next_state(state_id, enable + 2 * mode) == (next_state_id < fsm.get_num_states() ? next_state_id : static_cast<size_t>(-1)));
+        CHECK(ranges::equal(loaded.get_outputs(), fsm.get_outputs()));
+    }
+    mapped.close();
+
+    //Corrupt files: every change of a valid file must be rejected
+    const auto bytes = read_file(path);
+    const size_t state_names_offset = get_word(bytes, 12 * 8);
+    const size_t state_names_ids = get_word(bytes, state_names_offset);
+    const size_t sorted_index = state_names_offset + (3 + 2 * state_names_ids) * 8;
+    const auto rejects = [&](const auto& corrupt){
+        auto corrupted = bytes;
+        corrupt(corrupted);
+        write_file(corrupt_path, corrupted);
+        mapped_moore_fsm m;
+        return m.open(corrupt_path) == 2;
+    };
+    CHECK(!rejects([](vector<char>&){}));
+    CHECK(rejects([](vector<char>& b){b[0] = 'X';}));
+    CHECK(rejects([](vector<char>& b){b.resize(b.size() - 8);}));
+    CHECK(rejects([](vector<char>& b){set_word(b, 6 * 8, 15);}));                                     //Initial state out of range
+    CHECK(rejects([](vector<char>& b){set_word(b, 12 * 8, get_word(b, 12 * 8) - 4);}));               //Misaligned name table
+    CHECK(rejects([&](vector<char>& b){set_word(b, state_names_offset, state_names_ids + 1);}));    //Name table of the wrong size
+    CHECK(rejects([&](vector<char>& b){set_word(b, sorted_index + 2 * 8, 15);}));                   //Name of an id out of range
+    CHECK(rejects([&](vector<char>& b){set_word(b, sorted_index + 2 * 8, uint64_t(1) << 40);}));
+    CHECK(rejects([&](vector<char>& b){set_word(b, sorted_index + 8, uint64_t(1) << 40);}));        //Name out of the characters
+    CHECK(rejects([&](vector<char>& b){set_word(b, state_names_offset + 4 * 8, uint64_t(1) << 40);}));
+    CHECK(rejects([&](vector<char>& b){                                                             //Names not sorted
+        for(size_t w = 0; w < 3; ++w){
+            const auto first = get_word(b, sorted_index + w * 8);
+            set_word(b, sorted_index + w * 8, get_word(b, sorted_index + (3 + w) * 8));
+            set_word(b, sorted_index + (3 + w) * 8, first);
+        }
+    }));
+
+    filesystem::remove(path);
+    filesystem::remove(corrupt_path);
+
+    if(num_failures == 0)
+        cout << "binary_test: ok" << endl;
+    return num_failures;
+}
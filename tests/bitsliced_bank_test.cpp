@@ -0,0 +1,109 @@
+/*
+Checks that every instance of a moore_fsm_bitsliced_bank steps exactly like its own moore_fsm, with different inputs per instance,
+instances set one by one or a word at a time, and invalid transitions, and that the machines it can't run are rejected.
+*/
+
+#include <array>
+#include <vector>
+#include <random>
+#include <stdexcept>
+#include "fsmlib.hpp"
+#include "check.hpp"
+
+using namespace std;
+
+//Random tabulated boolean machine, one transition in ten invalid
+static moore_fsm make_machine(const size_t& num_inputs, const size_t& num_outputs, const size_t& num_states, mt19937_64& rng){
+    const size_t num_encoded_inputs = size_t(1) << num_inputs;
+    vector<size_t> table(num_states * num_encoded_inputs);
+    for(auto& next_state_id : table)
+        next_state_id = rng() % 10 == 0 ? static_cast<size_t>(-1) : rng() % num_states;
+
+    vector<size_t> outputs(num_states * num_outputs);
+    for(auto& output : outputs)
+        output = rng() % 2;
+
+    auto fsm = moore_fsm::from_transition_table(vector<size_t>(num_inputs, 2), num_outputs, outputs, table);
+    fsm.set_current_state(rng() % num_states);
+    return fsm;
+}
+
+int main(){
+    mt19937_64 rng(16);
+
+    for(const auto& [num_inputs, num_outputs, num_states] : vector<array<size_t, 3>>{{1, 1, 1}, {2, 3, 5}, {3, 2, 17}, {4, 1, 64}}){
+        //Not a multiple of 64, so the last word is partly unused
+        const size_t num_instances = 150;
+        auto fsm = make_machine(num_inputs, num_outputs, num_states, rng);
+        moore_fsm_bitsliced_bank bank(fsm, num_instances);
+        vector<moore_fsm> references(num_instances, fsm);
+        CHECK(bank.get_num_words() == 3);
+
+        for(size_t k = 0; k < 200; ++k){
+            if(k % 7 == 0){
+                //A whole word of channels at once
+                const auto word = rng() % bank.get_num_words();
+                const auto input = rng() % num_inputs;
+                const uint64_t bits = rng();
+                CHECK(bank.set_input_word(word, input, bits) == 0);
+                for(size_t c = 0; c < 64 && 64 * word + c < num_instances; ++c)
+                    references[64 * word + c].set_input(input, (bits >> c) & 1);
+            } else {
+                for(size_t i = 0; i < num_instances; ++i){
+                    if(rng() % 4 == 0){
+                        const auto input = rng() % num_inputs;
+                        const auto value = rng() % 2;
+                        CHECK(bank.set_input(i, input, value) == 0);
+                        references[i].set_input(input, value);
+                    }
+                }
+            }
+
+            bank.step_all();
+            for(auto& reference : references)
+                reference.step_machine();
+
+            for(size_t i = 0; i < num_instances; ++i){
+                CHECK(bank.get_current_state_id(i) == references[i].get_current_state_id());
+                for(size_t o = 0; o < num_outputs; ++o)
+                    CHECK(bank.get_output(i, o) == references[i].get_outputs()[o]);
+            }
+            for(size_t o = 0; o < num_outputs; ++o){
+                uint64_t bits = 0;
+                for(size_t c = 0; c < 64; ++c)
+                    bits |= static_cast<uint64_t>(references[64 + c].get_outputs()[o]) << c;
+                CHECK(bank.get_output_word(1, o) == bits);
+            }
+        }
+
+        //Moving a single instance
+        CHECK(bank.set_current_state(5, num_states - 1) == 0);
+        references[5].set_current_state(num_states - 1);
+        bank.step_all(4);
+        references[5].step_machine(4);
+        CHECK(bank.get_current_state_id(5) == references[5].get_current_state_id());
+        CHECK(bank.set_current_state(num_instances, 0) != 0);
+        CHECK(bank.set_input(0, 0, 2) != 0);
+    }
+
+    //Only compiled boolean machines with a current state
+    const auto throws = [](const moore_fsm& fsm){
+        try {
+            moore_fsm_bitsliced_bank bank(fsm, 64);
+        } catch(const invalid_argument&) {
+            return true;
+        }
+        return false;
+    };
+    auto fsm = make_machine(2, 2, 4, rng);
+    CHECK(!throws(fsm));
+    CHECK(throws(moore_fsm::from_transition_table({3}, 1, {0}, {0, 0, 0})));
+    CHECK(throws(moore_fsm::from_transition_table({2}, 1, {2}, {0, 0})));
+    vector<size_t> old_to_new_state_id;
+    CHECK(fsm.remove_state(fsm.get_current_state_id(), old_to_new_state_id) == 0);
+    CHECK(throws(fsm));
+
+    if(num_failures == 0)
+        cout << "bitsliced_bank_test: ok" << endl;
+    return num_failures;
+}
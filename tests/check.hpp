@@ -0,0 +1,15 @@
+//Minimal checking helpers shared by the tests: every failed CHECK is reported and counted,
+//and the test program returns the number of failures.
+#pragma once
+
+#include <iostream>
+
+inline int num_failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if(!(condition)){ \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << std::endl; \
+            ++num_failures; \
+        } \
+    } while(0)
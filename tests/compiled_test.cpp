@@ -0,0 +1,110 @@
+/*
+Checks that a compiled moore_fsm behaves exactly like the same machine stepping through its transition functions:
+random inputs, some of them outside of their declared alphabet, are fed to both and the next states and the outputs are compared.
+*/
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <random>
+#include <filesystem>
+#include "fsmlib.hpp"
+#include "check.hpp"
+
+using namespace std;
+
+//Next state of the test machine, defined for any value of the inputs, in or out of their alphabet
+static size_t next_of(const size_t& state_id, const size_t& a, const size_t& b, const size_t& c, const size_t& num_states){
+    //Some transitions are invalid, to check that both paths leave the machine where it is
+    if((state_id + a + 2 * b + 3 * c) % 17 == 0)
+        return -1;
+    return (state_id * 31 + a * 7 + b * 13 + c * 29 + 5) % num_states;
+}
+
+//Machine with three inputs of alphabet sizes 2, 3 and 4, whose states alternate name based and handle based transition functions
+static moore_fsm make_machine(const size_t& num_states){
+    moore_fsm fsm{3, 2};
+    fsm.set_input_name(0, "a");
+    fsm.set_input_name(1, "b");
+    fsm.set_input_name(2, "c");
+
+    for(size_t s = 0; s < num_states; ++s){
+        const vector<size_t> outputs = {s % 5, s * 3};
+        if(s % 2 == 0)
+            fsm.add_state("s" + to_string(s), outputs, [=]tr_lamba -> size_t{
+                const auto next_state_id = next_of(s, inputs[name_to_input_id.at("a")], inputs[name_to_input_id.at("b")], inputs[name_to_input_id.at("c")], num_states);
+                return next_state_id < num_states ? name_to_state_id.at("s" + to_string(next_state_id)) : next_state_id;
+            });
+        else
+            fsm.add_state("s" + to_string(s), outputs, [=](input_view inputs) -> size_t{
+                return next_of(s, inputs[0], inputs[1], inputs[2], num_states);
+            });
+    }
+
+    fsm.set_input_alphabet_size(0, 2);
+    fsm.set_input_alphabet_size(1, 3);
+    fsm.set_input_alphabet_size(2, 4);
+    fsm.set_current_state(0);
+    return fsm;
+}
+
+int main(){
+    const size_t num_states = 50;
+    auto reference = make_machine(num_states);
+    auto compiled = make_machine(num_states);
+    CHECK(compiled.compile() == 0);
+    CHECK(compiled.is_compiled());
+    CHECK(!reference.is_compiled());
+
+    mt19937_64 rng(1);
+    for(size_t k = 0; k < 100000; ++k){
+        //One step in eight has an input outside of its alphabet
+        const bool outside = rng() % 8 == 0;
+        const vector<size_t> inputs = {rng() % (outside ? 5 : 2), rng() % 3, rng() % 4};
+        reference.set_inputs(inputs);
+        compiled.set_inputs(inputs);
+
+        const auto reference_state = reference.step_machine();
+        const auto compiled_state = compiled.step_machine();
+        CHECK(reference_state == compiled_state);
+        CHECK(reference.get_current_state_id() == compiled.get_current_state_id());
+        CHECK(ranges::equal(reference.get_outputs(), compiled.get_outputs()));
+
+        //The next state from any state, not only from the current one
+        const auto state_id = rng() % num_states;
+        CHECK(reference.get_next_state(state_id, inputs) == compiled.get_next_state(state_id, inputs));
+
+        if(num_failures > 10)
+            break;
+    }
+
+    //Whole traces through run take the same paths
+    vector<size_t> trace(3 * 10000);
+    for(size_t k = 0; k < trace.size(); k += 3){
+        trace[k] = rng() % 3;
+        trace[k + 1] = rng() % 3;
+        trace[k + 2] = rng() % 4;
+    }
+    vector<size_t> reference_states(10000), compiled_states(10000);
+    CHECK(reference.run(trace, reference_states) == compiled.run(trace, compiled_states));
+    CHECK(reference_states == compiled_states);
+
+    //Renaming keeps the table, so machines built from a table can still be saved and run in banks
+    auto tabulated = moore_fsm::from_transition_table({2}, 1, {0, 1, 2}, {1, 0, 2, 1, 0, 2});
+    CHECK(tabulated.set_input_name(0, "in") == 0);
+    CHECK(tabulated.set_output_name(0, "out") == 0);
+    CHECK(tabulated.set_state_name(1, "one") == 0);
+    CHECK(tabulated.is_compiled());
+    CHECK(tabulated.get_state_id("one") == 1);
+    tabulated.set_current_state(0);
+    tabulated.set_input(0, 1);
+    moore_fsm_bank bank(tabulated, 2);
+    bank.step_all();
+    CHECK(tabulated.step_machine() == 0 && bank.get_current_state_id(1) == 0);
+    CHECK(tabulated.save_binary((filesystem::temp_directory_path() / "fsmlib_compiled_test.bin").string()) == 0);
+    filesystem::remove(filesystem::temp_directory_path() / "fsmlib_compiled_test.bin");
+
+    if(num_failures == 0)
+        cout << "compiled_test: ok" << endl;
+    return num_failures;
+}
@@ -0,0 +1,107 @@
+/*
+Checks that the product built by moore_fsm::compose steps like its components stepped in lockstep, with inputs shared by name
+and invalid transitions, and that the max_states cap is all or nothing.
+*/
+
+#include <vector>
+#include <string>
+#include <random>
+#include <algorithm>
+#include "fsmlib.hpp"
+#include "check.hpp"
+
+using namespace std;
+
+//Random handle based machine over the named inputs, with the given alphabet sizes, one transition in twenty invalid
+static moore_fsm make_machine(const vector<string>& input_names, const vector<size_t>& alphabet_sizes, const size_t& num_states, mt19937_64& rng){
+    moore_fsm fsm(input_names.size(), 2);
+    for(size_t i = 0; i < input_names.size(); ++i){
+        fsm.set_input_name(i, input_names[i]);
+        fsm.set_input_alphabet_size(i, alphabet_sizes[i]);
+    }
+    fsm.set_output_name(1, "random");
+
+    const auto seed = rng();
+    for(size_t s = 0; s < num_states; ++s)
+        fsm.add_state({s, rng() % 7}, [s, seed, num_states](input_view inputs) -> size_t{
+            size_t hash = seed ^ (s * 0x9e3779b97f4a7c15);
+            for(size_t i = 0; i < inputs.size(); ++i)
+                hash = (hash ^ inputs[i]) * 0x100000001b3;
+            return (hash >> 7) % 20 == 0 ? static_cast<size_t>(-1) : (hash >> 17) % num_states;
+        });
+    fsm.set_current_state(rng() % num_states);
+    return fsm;
+}
+
+int main(){
+    mt19937_64 rng(23);
+
+    //"b" is shared by the first two components, "c" by the last two
+    vector<moore_fsm> components;
+    components.push_back(make_machine({"a", "b"}, {2, 3}, 6, rng));
+    components.push_back(make_machine({"b"}, {3}, 4, rng));
+    components.push_back(make_machine({"c", "b"}, {2, 3}, 5, rng));
+    const vector<const moore_fsm*> pointers = {&components[0], &components[1], &components[2]};
+    const vector<string> prefixes = {"x", "y", "z"};
+
+    moore_fsm product(0, 0);
+    CHECK(moore_fsm::compose(pointers, prefixes, 1000, product) == 0);
+    CHECK(product.is_compiled());
+    CHECK(product.get_num_inputs() == 3 && product.get_num_outputs() == 6);
+    CHECK(product.get_input_id("a") == 0 && product.get_input_id("b") == 1 && product.get_input_id("c") == 2);
+    CHECK(product.get_output_id("y.random") == 3);
+    CHECK(product.get_num_states() <= 6 * 4 * 5);
+
+    size_t num_invalid = 0;
+    for(size_t k = 0; k < 20000; ++k){
+        const size_t a = rng() % 2, b = rng() % 3, c = rng() % 2;
+        CHECK(product.set_inputs({a, b, c}) == 0);
+        components[0].set_inputs({a, b});
+        components[1].set_inputs({b});
+        components[2].set_inputs({c, b});
+
+        //An invalid transition of any component is an invalid transition of the product, which then stays where it is
+        vector<size_t> next_states;
+        vector<moore_fsm> next_components = components;
+        for(auto& component : next_components)
+            next_states.push_back(component.step_machine());
+        const bool valid = ranges::none_of(next_states, [](const size_t& s){return s == static_cast<size_t>(-1);});
+        if(valid)
+            components = next_components;
+        else
+            ++num_invalid;
+
+        CHECK((product.step_machine() != static_cast<size_t>(-1)) == valid);
+        string name;
+        vector<size_t> outputs;
+        for(const auto& component : components){
+            name += (name.empty() ? "" : "|") + component.get_current_state_name();
+            outputs.insert(outputs.end(), component.get_outputs().begin(), component.get_outputs().end());
+        }
+        CHECK(product.get_current_state_name() == name);
+        CHECK(ranges::equal(product.get_outputs(), outputs));
+    }
+    CHECK(num_invalid > 0);
+
+    //The cap: one state too few fails without touching the product, the exact count succeeds
+    moore_fsm capped(0, 0);
+    CHECK(moore_fsm::compose(pointers, prefixes, 1000, capped) == 0);
+    const auto num_states = capped.get_num_states();
+    CHECK(num_states > 1);
+    moore_fsm untouched = moore_fsm::from_transition_table({2}, 1, {9}, {0, 0});
+    untouched.set_current_state(0);
+    CHECK(moore_fsm::compose(pointers, prefixes, num_states - 1, untouched) == 3);
+    CHECK(untouched.get_num_states() == 1 && untouched.get_outputs()[0] == 9);
+    CHECK(moore_fsm::compose(pointers, prefixes, num_states, untouched) == 0);
+    CHECK(untouched.get_num_states() == num_states);
+
+    //Errors
+    CHECK(moore_fsm::compose({}, {}, 1000, product) == 1);
+    CHECK(moore_fsm::compose(pointers, {"x"}, 1000, product) == 1);
+    auto other_alphabet = make_machine({"b"}, {4}, 2, rng);
+    CHECK(moore_fsm::compose({&components[0], &other_alphabet}, {"x", "y"}, 1000, product) == 2);
+
+    if(num_failures == 0)
+        cout << "compose_test: ok" << endl;
+    return num_failures;
+}
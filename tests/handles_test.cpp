@@ -0,0 +1,99 @@
+/*
+Checks that handle based transition functions give the same machine as name based ones: the same random graph is built with
+name lookups, with handles resolved up front through declare_state/define_state, and with add_states, and the machines are stepped side by side.
+*/
+
+#include <vector>
+#include <string>
+#include <random>
+#include <algorithm>
+#include "fsmlib.hpp"
+#include "check.hpp"
+
+using namespace std;
+
+int main(){
+    mt19937_64 rng(8);
+
+    //Random graph over two inputs: next[s][a][b], with the values of the inputs taken modulo 3, one transition in ten invalid
+    const size_t num_states = 60;
+    vector<size_t> next(num_states * 9);
+    for(auto& next_state_id : next)
+        next_state_id = rng() % 10 == 0 ? static_cast<size_t>(-1) : rng() % num_states;
+    const auto name_of = [](const size_t& s){return "s" + to_string(s);};
+    const auto index = [](const size_t& s, const size_t& a, const size_t& b){return s * 9 + (a % 3) * 3 + b % 3;};
+
+    //Name based: inputs and next states looked up by name at every step
+    moore_fsm by_name(2, 1);
+    by_name.set_input_name(0, "a");
+    by_name.set_input_name(1, "b");
+    for(size_t s = 0; s < num_states; ++s)
+        by_name.add_state(name_of(s), {s}, [=]tr_lamba -> size_t{
+            const auto next_state_id = next[index(s, inputs[name_to_input_id.at("a")], inputs[name_to_input_id.at("b")])];
+            return next_state_id < num_states ? name_to_state_id.at(name_of(next_state_id)) : next_state_id;
+        });
+
+    //Handle based, with the states declared in reverse order, so that most transitions reference states not defined yet
+    moore_fsm by_handle(2, 1);
+    by_handle.set_input_name(0, "a");
+    by_handle.set_input_name(1, "b");
+    const auto a = by_handle.get_input_id("a");
+    const auto b = by_handle.get_input_id("b");
+    vector<size_t> handles(num_states);
+    for(size_t s = num_states; s-- > 0;)
+        handles[s] = by_handle.declare_state(name_of(s));
+    CHECK(by_handle.declare_state(name_of(7)) == handles[7]);
+    for(size_t s = 0; s < num_states; ++s)
+        CHECK(by_handle.define_state(handles[s], {s}, [=](input_view inputs) -> size_t{
+            const auto next_state_id = next[index(s, inputs[a], inputs[b])];
+            return next_state_id < num_states ? handles[next_state_id] : next_state_id;
+        }) == 0);
+
+    //Handle based, added in bulk
+    moore_fsm bulk(2, 1);
+    vector<string> names;
+    vector<vector<size_t>> outputs;
+    vector<handle_transition_fn> transition_fns;
+    for(size_t s = 0; s < num_states; ++s){
+        names.push_back(name_of(s));
+        outputs.push_back({s});
+        transition_fns.push_back([=](input_view inputs) -> size_t{return next[index(s, inputs[0], inputs[1])];});
+    }
+    vector<size_t> state_ids;
+    CHECK(bulk.add_states(names, outputs, transition_fns, state_ids) == 0);
+    CHECK(state_ids.size() == num_states && state_ids[5] == 5);
+    outputs.pop_back();
+    CHECK(bulk.add_states(names, outputs, transition_fns, state_ids) == 1);
+
+    by_name.set_current_state(name_of(0));
+    by_handle.set_current_state(name_of(0));
+    bulk.set_current_state(name_of(0));
+    for(size_t k = 0; k < 20000; ++k){
+        //Input values are not limited to an alphabet
+        const vector<size_t> inputs = {rng() % 5, rng() % 4};
+        by_name.set_inputs(inputs);
+        by_handle.set_inputs(inputs);
+        bulk.set_inputs(inputs);
+
+        const auto next_state_id = by_name.step_machine();
+        CHECK(by_handle.get_state_name(by_handle.step_machine()) == by_name.get_state_name(next_state_id));
+        CHECK(bulk.step_machine() == next_state_id);
+        CHECK(by_handle.get_current_state_name() == by_name.get_current_state_name());
+        CHECK(ranges::equal(by_handle.get_outputs(), by_name.get_outputs()));
+        CHECK(ranges::equal(bulk.get_outputs(), by_name.get_outputs()));
+    }
+
+    //A declared state that is never defined is a dead end
+    moore_fsm partial(1, 1);
+    const auto later = partial.declare_state("later");
+    const auto defined = partial.add_state({1}, [later](input_view) -> size_t{return later;});
+    partial.set_current_state(defined);
+    CHECK(partial.step_machine() == later);
+    CHECK(partial.step_machine() == static_cast<size_t>(-1));
+    CHECK(partial.get_current_state_id() == later);
+    CHECK(partial.define_state(partial.get_num_states(), {0}, [](input_view) -> size_t{return 0;}) == 1);
+
+    if(num_failures == 0)
+        cout << "handles_test: ok" << endl;
+    return num_failures;
+}
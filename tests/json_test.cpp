@@ -0,0 +1,79 @@
+/*
+Checks the JSON descriptions of the machines: a written machine is read back with the same transitions, also when it isn't compiled,
+writing stays fast for large machines, and malformed descriptions are rejected.
+*/
+
+#include <vector>
+#include <string>
+#include <chrono>
+#include <stdexcept>
+#include "fsmlib.hpp"
+#include "check.hpp"
+
+using namespace std;
+
+static bool rejects(const string& description){
+    try {
+        from_string(description);
+    } catch(const invalid_argument&) {
+        return true;
+    }
+    return false;
+}
+
+int main(){
+    //Large machine with a ring of states: writing it must be linear in the size of the transition table
+    const size_t num_states = 100000;
+    vector<size_t> table(num_states * 2), outputs(num_states);
+    for(size_t s = 0; s < num_states; ++s){
+        table[2 * s] = s;
+        table[2 * s + 1] = s % 1000 == 999 ? static_cast<size_t>(-1) : (s + 1) % num_states;
+        outputs[s] = s % 7;
+    }
+    const auto fsm = moore_fsm::from_transition_table({2}, 1, outputs, table);
+
+    const auto start = chrono::steady_clock::now();
+    const auto description = to_string(fsm);
+    const auto seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    CHECK(seconds < 5);
+
+    const auto read_back = from_string(description);
+    CHECK(read_back.is_compiled());
+    CHECK(read_back.get_num_states() == num_states);
+    CHECK(read_back.get_transition_table() == fsm.get_transition_table());
+    for(size_t s = 0; s < num_states; s += 997)
+        CHECK(read_back.get_state_outputs(s)[0] == outputs[s]);
+
+    //An uncompiled machine is written with its transitions, a machine that can't be compiled isn't written
+    moore_fsm uncompiled(1, 1);
+    uncompiled.set_input_alphabet_size(0, 3);
+    for(size_t s = 0; s < 4; ++s)
+        uncompiled.add_state({s}, [s](input_view inputs) -> size_t{return inputs[0] == 2 ? -1 : (s + inputs[0]) % 4;});
+    CHECK(!uncompiled.is_compiled());
+    auto compiled = uncompiled;
+    compiled.compile();
+    CHECK(from_string(to_string(uncompiled)).get_transition_table() == compiled.get_transition_table());
+    moore_fsm no_alphabet(1, 1);
+    no_alphabet.add_state({0}, [](input_view) -> size_t{return 0;});
+    CHECK(to_string(no_alphabet).empty());
+
+    //Unknown keys may hold any JSON value, but only valid ones
+    const string states = R"("states":[{"name":"a","outputs":[0],"edges":[{"next":"a"}]}])";
+    const string known = R"("num_inputs":1,"num_outputs":1,)" + states;
+    for(const auto value : {"true", "false", "null", "0", "-12", "3.25", "-1.5e+3", "2E7", R"("x")", "[]", R"([1,{"a":[null]}])", "{}"})
+        CHECK(!rejects(R"({"unknown":)" + string(value) + "," + known + "}"));
+    for(const auto value : {"", "foo", "tru", "nul", "+1", "01", "1.", ".5", "1e", "-", R"([1,])", R"({"a"})"})
+        CHECK(rejects(R"({"unknown":)" + string(value) + "," + known + "}"));
+
+    //Malformed descriptions
+    CHECK(!rejects(R"({"num_inputs":1,"num_outputs":1,)" + states + "}"));
+    CHECK(!rejects(R"({"num_inputs":1,"num_outputs":1,"num_states":1,)" + states + "}"));
+    CHECK(rejects(R"({"num_inputs":1,"num_outputs":1,"num_states":2,)" + states + "}"));
+    CHECK(rejects(R"({"num_inputs":1,"num_outputs":1,"num_states":1000000000000000,)" + states + "}"));
+    CHECK(rejects(R"({"num_inputs":1,"num_outputs":1,"states":[{"name":"a","outputs":[0],"edges":[{"when":{"0":1}}]}]})"));
+    CHECK(!rejects(R"({"num_inputs":1,"num_outputs":1,"states":[{"name":"a","outputs":[0],"edges":[{"next":null}]}]})"));
+
+    if(num_failures == 0)
+        cout << "json_test: ok" << endl;
+    return num_failures;
+}
@@ -0,0 +1,103 @@
+/*
+Checks that a mealy_fsm steps like its emulation by a moore_fsm, which needs a state for every pair of Mealy state and last
+transition taken, with inputs in and out of their alphabets, invalid transitions, and whole traces through run.
+*/
+
+#include <vector>
+#include <random>
+#include <algorithm>
+#include "fsmlib.hpp"
+#include "check.hpp"
+
+using namespace std;
+
+int main(){
+    mt19937_64 rng(11);
+
+    //Random Mealy machine with inputs of alphabet sizes 2 and 3 and two outputs, one transition in ten invalid
+    const size_t num_states = 8, num_encoded_inputs = 6, num_outputs = 2;
+    vector<size_t> next(num_states * num_encoded_inputs), outputs(num_states * num_encoded_inputs * num_outputs);
+    for(auto& next_state_id : next)
+        next_state_id = rng() % 10 == 0 ? static_cast<size_t>(-1) : rng() % num_states;
+    for(auto& output : outputs)
+        output = rng() % 100;
+
+    mealy_fsm mealy({2, 3}, num_outputs);
+    for(size_t s = 0; s < num_states; ++s)
+        mealy.add_state();
+    for(size_t s = 0; s < num_states; ++s){
+        //Half of the states from a function, the other half one transition at a time
+        if(s % 2 == 0)
+            CHECK(mealy.set_transitions(s, [&, s](input_view inputs) -> mealy_transition{
+                const auto entry = s * num_encoded_inputs + inputs[0] + 2 * inputs[1];
+                return {next[entry], {outputs[entry * num_outputs], outputs[entry * num_outputs + 1]}};
+            }) == 0);
+        else
+            for(size_t a = 0; a < 2; ++a)
+                for(size_t b = 0; b < 3; ++b){
+                    const auto entry = s * num_encoded_inputs + a + 2 * b;
+                    CHECK(mealy.set_transition(s, {a, b}, next[entry], {outputs[entry * num_outputs], outputs[entry * num_outputs + 1]}) == 0);
+                }
+    }
+
+    //Moore emulation: state s * (num_entries + 1) + e is in Mealy state s after taking entry e, e == num_entries before the first step
+    const size_t num_entries = num_states * num_encoded_inputs;
+    moore_fsm moore(2, num_outputs);
+    for(size_t s = 0; s < num_states; ++s)
+        for(size_t e = 0; e <= num_entries; ++e){
+            vector<size_t> state_outputs(num_outputs, 0);
+            if(e < num_entries)
+                state_outputs = {outputs[e * num_outputs], outputs[e * num_outputs + 1]};
+            moore.add_state(state_outputs, [&, s](input_view inputs) -> size_t{
+                if(inputs[0] >= 2 || inputs[1] >= 3)
+                    return -1;
+                const auto entry = s * num_encoded_inputs + inputs[0] + 2 * inputs[1];
+                return next[entry] < num_states ? next[entry] * (num_entries + 1) + entry : static_cast<size_t>(-1);
+            });
+        }
+
+    const size_t initial_state = 3;
+    CHECK(mealy.set_current_state(initial_state) == 0);
+    moore.set_current_state(initial_state * (num_entries + 1) + num_entries);
+    CHECK(ranges::equal(mealy.get_outputs(), moore.get_outputs()));
+    CHECK(mealy.step_machine(0) == 0 && mealy.get_current_state_id() == initial_state);
+
+    for(size_t k = 0; k < 20000; ++k){
+        //One step in ten has an input outside of its alphabet
+        const vector<size_t> inputs = {rng() % (rng() % 10 == 0 ? 3 : 2), rng() % 3};
+        mealy.set_inputs(inputs);
+        moore.set_inputs(inputs);
+
+        const size_t num_steps = 1 + rng() % 2;
+        const auto next_state_id = moore.step_machine(num_steps);
+        CHECK(mealy.step_machine(num_steps) == (next_state_id == static_cast<size_t>(-1) ? next_state_id : next_state_id / (num_entries + 1)));
+        CHECK(mealy.get_current_state_id() == moore.get_current_state_id() / (num_entries + 1));
+        CHECK(ranges::equal(mealy.get_outputs(), moore.get_outputs()));
+    }
+
+    //Whole traces, in both trace modes
+    vector<size_t> trace(2 * 5000);
+    for(size_t k = 0; k < trace.size(); k += 2){
+        trace[k] = rng() % 2;
+        trace[k + 1] = rng() % 3;
+    }
+    vector<size_t> mealy_outputs(num_outputs * 5000), moore_outputs(num_outputs * 5000);
+    const auto final_state_id = moore.run(trace, moore_outputs, trace_mode::outputs);
+    CHECK(mealy.run(trace, mealy_outputs, trace_mode::outputs) == (final_state_id == static_cast<size_t>(-1) ? final_state_id : final_state_id / (num_entries + 1)));
+    CHECK(mealy_outputs == moore_outputs);
+    vector<size_t> mealy_states(5000), moore_states(5000);
+    mealy.run(trace, mealy_states);
+    moore.run(trace, moore_states);
+    for(size_t k = 0; k < 5000; ++k)
+        CHECK(mealy_states[k] == (moore_states[k] == static_cast<size_t>(-1) ? moore_states[k] : moore_states[k] / (num_entries + 1)));
+
+    //Invalid arguments
+    CHECK(mealy.set_transition(num_states, {0, 0}, 0, {0, 0}) == 1);
+    CHECK(mealy.set_transition(0, {2, 0}, 0, {0, 0}) == 1);
+    CHECK(mealy.set_transition(0, {0, 0}, 0, {0}) == 2);
+    CHECK(mealy.set_current_state(num_states) == 1);
+
+    if(num_failures == 0)
+        cout << "mealy_test: ok" << endl;
+    return num_failures;
+}
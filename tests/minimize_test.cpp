@@ -0,0 +1,99 @@
+/*
+Checks that moore_fsm::minimize keeps the behaviour of the machine while dropping its equivalent states: machines built from
+copies of a smaller core machine are minimized and stepped side by side with the original, and the result can't be minimized further.
+*/
+
+#include <vector>
+#include <string>
+#include <random>
+#include <algorithm>
+#include "fsmlib.hpp"
+#include "check.hpp"
+
+using namespace std;
+
+//Machine with num_copies copies of every state of a random core machine with inputs of alphabet sizes 2 and 2:
+//state s behaves like core state s % core_states and its transitions go to random copies of the core targets
+static moore_fsm make_machine(const size_t& core_states, const size_t& num_copies, mt19937_64& rng){
+    vector<size_t> core_table(core_states * 4), core_outputs(core_states);
+    for(auto& next_state_id : core_table)
+        next_state_id = rng() % 12 == 0 ? static_cast<size_t>(-1) : rng() % core_states;
+    for(auto& output : core_outputs)
+        output = rng() % 3;
+
+    const auto num_states = core_states * num_copies;
+    vector<size_t> table(num_states * 4), outputs(num_states);
+    for(size_t s = 0; s < num_states; ++s){
+        outputs[s] = core_outputs[s % core_states];
+        for(size_t e = 0; e < 4; ++e){
+            const auto target = core_table[(s % core_states) * 4 + e];
+            table[s * 4 + e] = target == static_cast<size_t>(-1) ? target : target + core_states * (rng() % num_copies);
+        }
+    }
+
+    auto fsm = moore_fsm::from_transition_table({2, 2}, 1, outputs, table);
+    for(size_t s = 0; s < num_states; ++s)
+        fsm.set_state_name(s, "s" + to_string(s));
+    fsm.set_current_state(rng() % num_states);
+    return fsm;
+}
+
+int main(){
+    mt19937_64 rng(6);
+
+    for(const auto& [core_states, num_copies] : vector<pair<size_t, size_t>>{{1, 3}, {5, 4}, {40, 3}}){
+        auto fsm = make_machine(core_states, num_copies, rng);
+        fsm.set_inputs({1, 0});
+
+        moore_fsm minimized(0, 0);
+        vector<size_t> old_to_new_state_id;
+        CHECK(fsm.minimize(minimized, old_to_new_state_id) == 0);
+        CHECK(minimized.is_compiled());
+        CHECK(minimized.get_num_states() <= core_states);
+        CHECK(minimized.get_num_states() < fsm.get_num_states());
+        CHECK(old_to_new_state_id.size() == fsm.get_num_states());
+
+        //Merged states have the same outputs, keep their names, and the ids are numbered by the smallest old id
+        size_t last_new_id = 0;
+        for(size_t s = 0; s < fsm.get_num_states(); ++s){
+            const auto new_id = old_to_new_state_id[s];
+            CHECK(new_id < minimized.get_num_states());
+            CHECK(ranges::equal(minimized.get_state_outputs(new_id), fsm.get_state_outputs(s)));
+            CHECK(minimized.get_state_id("s" + to_string(s)) == new_id);
+            CHECK(new_id <= last_new_id + 1);
+            last_new_id = max(last_new_id, new_id);
+        }
+        CHECK(minimized.get_current_state_id() == old_to_new_state_id[fsm.get_current_state_id()]);
+        CHECK(minimized.get_inputs() == fsm.get_inputs());
+
+        //The same outputs for random inputs, and the same invalid transitions
+        for(size_t k = 0; k < 20000; ++k){
+            const vector<size_t> inputs = {rng() % 2, rng() % 2};
+            fsm.set_inputs(inputs);
+            minimized.set_inputs(inputs);
+            const auto next_state_id = fsm.step_machine();
+            const auto minimized_next_state_id = minimized.step_machine();
+            CHECK((next_state_id == static_cast<size_t>(-1)) == (minimized_next_state_id == static_cast<size_t>(-1)));
+            CHECK(minimized.get_current_state_id() == old_to_new_state_id[fsm.get_current_state_id()]);
+            CHECK(ranges::equal(minimized.get_outputs(), fsm.get_outputs()));
+        }
+
+        //A minimal machine stays as it is
+        moore_fsm twice(0, 0);
+        vector<size_t> identity;
+        CHECK(minimized.minimize(twice, identity) == 0);
+        CHECK(twice.get_num_states() == minimized.get_num_states());
+        CHECK(twice.get_transition_table() == minimized.get_transition_table());
+    }
+
+    //The machine has to be compiled
+    moore_fsm uncompiled(1, 1);
+    uncompiled.add_state({0}, [](input_view) -> size_t{return 0;});
+    moore_fsm minimized(0, 0);
+    vector<size_t> old_to_new_state_id;
+    CHECK(uncompiled.minimize(minimized, old_to_new_state_id) == 1);
+
+    if(num_failures == 0)
+        cout << "minimize_test: ok" << endl;
+    return num_failures;
+}
@@ -0,0 +1,95 @@
+/*
+Checks that the machine built by moore_fsm::from_patterns reports, after every symbol, the same matches as a naive matcher
+comparing every pattern with the end of the stream, including duplicated patterns and patterns that are suffixes of others.
+*/
+
+#include <set>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <stdexcept>
+#include "fsmlib.hpp"
+#include "check.hpp"
+
+using namespace std;
+
+//Ids of the distinct patterns ending at position end of the stream, each one with the smallest index among its duplicates
+static set<size_t> naive_matches(const vector<vector<size_t>>& patterns, const vector<size_t>& stream, const size_t& end){
+    set<size_t> matches;
+    for(size_t p = 0; p < patterns.size(); ++p){
+        const auto& pattern = patterns[p];
+        if(pattern.size() > end + 1 || !equal(pattern.begin(), pattern.end(), stream.begin() + (end + 1 - pattern.size())))
+            continue;
+        if(ranges::find(patterns.begin(), patterns.begin() + p, pattern) == patterns.begin() + p)
+            matches.insert(p);
+    }
+    return matches;
+}
+
+int main(){
+    mt19937_64 rng(17);
+
+    for(const size_t alphabet_size : {1, 2, 4}){
+        //Short patterns over a small alphabet, so that they overlap, repeat and are suffixes of each other
+        vector<vector<size_t>> patterns(12);
+        for(auto& pattern : patterns){
+            pattern.resize(1 + rng() % 5);
+            for(auto& symbol : pattern)
+                symbol = rng() % alphabet_size;
+        }
+        patterns.push_back(patterns[3]);
+
+        vector<size_t> shorter_match;
+        auto fsm = moore_fsm::from_patterns(patterns, alphabet_size, shorter_match);
+        CHECK(fsm.is_compiled());
+        CHECK(fsm.get_input_id("symbol") == 0);
+        CHECK(fsm.get_output_id("match") == 0 && fsm.get_output_id("num_matches") == 1);
+        CHECK(shorter_match.size() == patterns.size());
+
+        vector<size_t> stream(3000);
+        for(auto& symbol : stream)
+            symbol = rng() % alphabet_size;
+
+        vector<size_t> step_outputs;
+        for(size_t k = 0; k < stream.size(); ++k){
+            fsm.set_input(0, stream[k]);
+            fsm.step_machine();
+            const auto expected = naive_matches(patterns, stream, k);
+            const auto outputs = fsm.get_outputs();
+            step_outputs.insert(step_outputs.end(), outputs.begin(), outputs.end());
+
+            //The longest match first, then the shorter ones through shorter_match
+            set<size_t> matches;
+            for(size_t match = outputs[0]; match != 0; match = shorter_match[match - 1])
+                matches.insert(match - 1);
+            CHECK(matches == expected);
+            CHECK(outputs[1] == expected.size());
+            for(const auto& p : expected)
+                CHECK(patterns[outputs[0] - 1].size() >= patterns[p].size());
+        }
+
+        //run gives the same outputs as the steps above
+        auto reference = moore_fsm::from_patterns(patterns, alphabet_size);
+        vector<size_t> run_outputs(2 * stream.size());
+        reference.run(stream, run_outputs, trace_mode::outputs);
+        CHECK(run_outputs == step_outputs);
+        CHECK(reference.get_current_state_id() == fsm.get_current_state_id());
+    }
+
+    //Empty patterns and symbols outside of the alphabet are rejected
+    const auto throws = [](const vector<vector<size_t>>& patterns){
+        try {
+            moore_fsm::from_patterns(patterns, 2);
+        } catch(const invalid_argument&) {
+            return true;
+        }
+        return false;
+    };
+    CHECK(!throws({{0, 1}, {1}}));
+    CHECK(throws({{0, 1}, {}}));
+    CHECK(throws({{0, 2}}));
+
+    if(num_failures == 0)
+        cout << "patterns_test: ok" << endl;
+    return num_failures;
+}
@@ -0,0 +1,173 @@
+/*
+Checks transition_profiler against counts taken from plain moore_fsm stepping: visits, edges and transition function calls of
+machines sharing a profiler from different threads, sampling, shards kept across attaches, and clear while the machines are stepping.
+*/
+
+#include <map>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <random>
+#include <numeric>
+#include <fstream>
+#include <filesystem>
+#include "fsmlib.hpp"
+#include "check.hpp"
+
+using namespace std;
+
+//Random handle based machine over one input of alphabet size 4, one transition in ten invalid
+static moore_fsm make_machine(const size_t& num_states, mt19937_64& rng){
+    vector<size_t> next(num_states * 4);
+    for(auto& next_state_id : next)
+        next_state_id = rng() % 10 == 0 ? static_cast<size_t>(-1) : rng() % num_states;
+
+    moore_fsm fsm(1, 1);
+    for(size_t s = 0; s < num_states; ++s)
+        fsm.add_state({s}, [s, next](input_view inputs) -> size_t{return next[s * 4 + inputs[0] % 4];});
+    fsm.set_current_state(0);
+    return fsm;
+}
+
+//Steps fsm num_steps times with random inputs, counting the visits and the edges as the profiler should
+struct counts {
+    vector<uint64_t> visits;
+    map<pair<size_t, size_t>, uint64_t> edges;
+};
+static void step(moore_fsm& fsm, const size_t& num_steps, const uint64_t& seed, counts* expected){
+    mt19937_64 rng(seed);
+    for(size_t k = 0; k < num_steps; ++k){
+        fsm.set_input(0, rng() % 4);
+        const auto from_state_id = fsm.get_current_state_id();
+        const auto to_state_id = fsm.step_machine();
+        if(expected == nullptr)
+            continue;
+        ++expected->edges[{from_state_id, to_state_id}];
+        if(to_state_id != static_cast<size_t>(-1)){
+            if(expected->visits.size() <= to_state_id)
+                expected->visits.resize(to_state_id + 1, 0);
+            ++expected->visits[to_state_id];
+        }
+    }
+}
+
+int main(){
+    mt19937_64 rng(19);
+    const size_t num_states = 40;
+
+    //Two machines sharing a profiler, stepped by two threads, against the counts of the same steps without a profiler
+    {
+        transition_profiler profiler;
+        auto first = make_machine(num_states, rng);
+        auto second = first;
+        auto first_reference = first, second_reference = first;
+        first.attach_profiler(profiler);
+        second.attach_profiler(profiler);
+
+        counts expected;
+        step(first_reference, 30000, 1, &expected);
+        step(second_reference, 30000, 2, &expected);
+        thread t1([&]{step(first, 30000, 1, nullptr);});
+        thread t2([&]{step(second, 30000, 2, nullptr);});
+        t1.join();
+        t2.join();
+
+        auto visits = profiler.get_state_visits();
+        while(!expected.visits.empty() && expected.visits.back() == 0)
+            expected.visits.pop_back();
+        CHECK(visits == expected.visits);
+        const auto edges = profiler.get_edge_counts();
+        CHECK(edges.size() == expected.edges.size());
+        for(const auto& e : edges)
+            CHECK(expected.edges[make_pair(e.from_state_id, e.to_state_id)] == e.count);
+
+        //Every step of these uncompiled machines calls a transition function
+        const auto times = profiler.get_transition_fn_times();
+        CHECK(accumulate(times.begin(), times.end(), uint64_t(0), [](const uint64_t& sum, const auto& t){return sum + t.calls;}) == 60000);
+
+        //The CSV has a row per counter, after the header
+        const auto path = (filesystem::temp_directory_path() / "fsmlib_profiler_test.csv").string();
+        CHECK(profiler.export_csv(path) == 0);
+        ifstream csv(path);
+        size_t num_rows = 0;
+        for(string line; getline(csv, line);)
+            ++num_rows;
+        const auto num_visited = count_if(visits.begin(), visits.end(), [](const uint64_t& v){return v != 0;});
+        CHECK(num_rows == 1 + num_visited + edges.size() + times.size());
+        filesystem::remove(path);
+    }
+
+    //Sampling one step every 8: every step is a visit, one step in 8 is an edge
+    {
+        transition_profiler profiler(8);
+        auto fsm = make_machine(num_states, rng);
+        fsm.set_input_alphabet_size(0, 4);
+        CHECK(fsm.compile() == 0);
+        auto reference = fsm;
+        fsm.attach_profiler(profiler);
+        counts expected;
+        step(reference, 8000, 3, &expected);
+        step(fsm, 8000, 3, nullptr);
+        const auto visits = profiler.get_state_visits();
+        CHECK(accumulate(visits.begin(), visits.end(), uint64_t(0)) == accumulate(expected.visits.begin(), expected.visits.end(), uint64_t(0)));
+        const auto edges = profiler.get_edge_counts();
+        CHECK(accumulate(edges.begin(), edges.end(), uint64_t(0), [](const uint64_t& sum, const auto& e){return sum + e.count;}) == 1000);
+        for(const auto& e : edges)
+            CHECK(e.count <= expected.edges[make_pair(e.from_state_id, e.to_state_id)]);
+
+        //Table lookups of a compiled machine aren't timed
+        CHECK(profiler.get_transition_fn_times().empty());
+    }
+
+    //A machine attached again keeps its shard, so detaching and attaching many times doesn't pile up shards
+    {
+        transition_profiler profiler;
+        auto fsm = make_machine(num_states, rng);
+        fsm.attach_profiler(profiler);
+        auto* const shard = profiler.add_shard(nullptr);
+        CHECK(profiler.add_shard(shard) == shard);
+        for(size_t k = 0; k < 1000; ++k){
+            fsm.detach_profiler();
+            step(fsm, 1, k, nullptr);
+            fsm.attach_profiler(profiler);
+            step(fsm, 1, k, nullptr);
+        }
+        const auto visits = profiler.get_state_visits();
+        const auto edges = profiler.get_edge_counts();
+        CHECK(accumulate(edges.begin(), edges.end(), uint64_t(0), [](const uint64_t& sum, const auto& e){return sum + e.count;}) == 1000);
+        CHECK(accumulate(visits.begin(), visits.end(), uint64_t(0)) <= 1000);
+    }
+
+    //Clearing while a machine steps, then counting again from zero
+    {
+        transition_profiler profiler;
+        auto fsm = make_machine(num_states, rng);
+        fsm.attach_profiler(profiler);
+        atomic<bool> done{false};
+        thread stepper([&]{
+            for(uint64_t seed = 0; !done.load(); ++seed)
+                step(fsm, 1000, seed, nullptr);
+        });
+        for(size_t k = 0; k < 200; ++k){
+            profiler.clear();
+            const auto visits = profiler.get_state_visits();
+            CHECK(accumulate(visits.begin(), visits.end(), uint64_t(0)) < (uint64_t(1) << 40));
+        }
+        done = true;
+        stepper.join();
+
+        profiler.clear();
+        CHECK(profiler.get_state_visits().empty() && profiler.get_edge_counts().empty() && profiler.get_transition_fn_times().empty());
+        auto reference = fsm;
+        counts expected;
+        step(reference, 5000, 4, &expected);
+        step(fsm, 5000, 4, nullptr);
+        while(!expected.visits.empty() && expected.visits.back() == 0)
+            expected.visits.pop_back();
+        CHECK(profiler.get_state_visits() == expected.visits);
+    }
+
+    if(num_failures == 0)
+        cout << "profiler_test: ok" << endl;
+    return num_failures;
+}
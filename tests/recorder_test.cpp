@@ -0,0 +1,124 @@
+/*
+Checks transition_recorder against a log of the transitions of a plain moore_fsm: the records kept, the dump file, the error dump
+written once per burst of invalid transitions, and the records read by another thread while the machine steps.
+*/
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <random>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include "fsmlib.hpp"
+#include "check.hpp"
+
+using namespace std;
+
+//Next state from state s with inputs a and b, invalid when a == 3
+static size_t next_of(const size_t& s, const size_t& a, const size_t& b){
+    return a == 3 ? static_cast<size_t>(-1) : (s * 5 + a * 3 + b + 1) % 13;
+}
+
+static moore_fsm make_machine(){
+    moore_fsm fsm(2, 1);
+    for(size_t s = 0; s < 13; ++s)
+        fsm.add_state({s}, [s](input_view inputs) -> size_t{return next_of(s, inputs[0], inputs[1]);});
+    fsm.set_current_state(0);
+    return fsm;
+}
+
+int main(){
+    mt19937_64 rng(18);
+    const auto error_path = (filesystem::temp_directory_path() / "fsmlib_recorder_test_error.bin").string();
+    const auto dump_path = (filesystem::temp_directory_path() / "fsmlib_recorder_test.bin").string();
+    filesystem::remove(error_path);
+
+    //The recorder keeps the last capacity transitions of the log, with their steps and inputs
+    auto reference = make_machine();
+    auto recorded = make_machine();
+    transition_recorder recorder(100, 2, error_path);
+    CHECK(recorder.get_record_size() == 5);
+    recorded.attach_recorder(recorder);
+
+    vector<uint64_t> log;
+    for(size_t k = 0; k < 1000; ++k){
+        const vector<size_t> inputs = {rng() % 3, rng() % 4};
+        reference.set_inputs(inputs);
+        recorded.set_inputs(inputs);
+        const auto from_state_id = reference.get_current_state_id();
+        const auto to_state_id = reference.step_machine();
+        CHECK(recorded.step_machine() == to_state_id);
+        log.insert(log.end(), {k, from_state_id, to_state_id, inputs[0], inputs[1]});
+    }
+    CHECK(recorder.get_num_recorded() == 1000);
+    vector<uint64_t> records;
+    CHECK(recorder.get_records(records) == 100);
+    CHECK(equal(records.begin(), records.end(), log.end() - 500));
+
+    //The dump holds the same records after its header
+    CHECK(recorder.dump(dump_path) == 0);
+    ifstream dump(dump_path, ios::binary);
+    vector<char> bytes((istreambuf_iterator<char>(dump)), {});
+    CHECK(bytes.size() == 48 + 500 * 8);
+    CHECK(memcmp(bytes.data(), "FSMLIBTR", 8) == 0);
+    uint64_t header[5];
+    memcpy(header, bytes.data() + 8, sizeof(header));
+    CHECK(header[1] == 5 && header[2] == 2 && header[3] == 100 && header[4] == 1000);
+    CHECK(memcmp(bytes.data() + 48, records.data(), 500 * 8) == 0);
+
+    //No invalid transition yet, then one dump for a burst of invalid transitions and another one for the next burst
+    CHECK(!filesystem::exists(error_path));
+    recorded.set_inputs({3, 0});
+    recorded.step_machine(5);
+    CHECK(filesystem::exists(error_path));
+    filesystem::remove(error_path);
+    recorded.step_machine(5);
+    CHECK(!filesystem::exists(error_path));
+    recorded.set_inputs({0, 0});
+    recorded.step_machine();
+    recorded.set_inputs({3, 0});
+    recorded.step_machine();
+    CHECK(filesystem::exists(error_path));
+
+    //Cleared, and detached
+    recorder.clear();
+    CHECK(recorder.get_num_recorded() == 0 && recorder.get_records(records) == 0);
+    recorded.detach_recorder();
+    recorded.step_machine();
+    CHECK(recorder.get_num_recorded() == 0);
+
+    //A reader thread never sees a torn record: every record it copies is a consistent transition, and the steps are consecutive
+    transition_recorder shared(64, 2);
+    auto writer = make_machine();
+    writer.attach_recorder(shared);
+    atomic<bool> done{false};
+    atomic<size_t> num_bad{0}, num_read{0};
+    thread reader([&]{
+        vector<uint64_t> out;
+        while(!done.load()){
+            const auto num_records = shared.get_records(out);
+            for(size_t r = 0; r < num_records; ++r){
+                const auto* const record = out.data() + r * 5;
+                if(record[2] != next_of(record[1], record[3], record[4]) || (r > 0 && record[0] <= record[-5]))
+                    ++num_bad;
+            }
+            num_read += num_records;
+        }
+    });
+    for(size_t k = 0; k < 2000000; ++k){
+        writer.set_inputs({k % 3, (k / 3) % 4});
+        writer.step_machine();
+    }
+    done = true;
+    reader.join();
+    CHECK(num_bad == 0);
+    CHECK(num_read > 0);
+
+    filesystem::remove(error_path);
+    filesystem::remove(dump_path);
+
+    if(num_failures == 0)
+        cout << "recorder_test: ok" << endl;
+    return num_failures;
+}
@@ -0,0 +1,106 @@
+/*
+Checks that removing states keeps the behaviour of the remaining ones: the name based transition functions see the live names,
+so a state added again under a removed name is reached by them, and random machines, compiled or not, step like the original
+after many states are removed at once, with the transitions into the removed states invalid.
+*/
+
+#include <vector>
+#include <string>
+#include <random>
+#include <algorithm>
+#include "fsmlib.hpp"
+#include "check.hpp"
+
+using namespace std;
+
+int main(){
+    //Ring A -> B -> C -> A on input 1, staying on input 0, written with names only
+    moore_fsm fsm(1, 1);
+    fsm.set_input_alphabet_size(0, 2);
+    const vector<string> names = {"A", "B", "C"};
+    for(size_t s = 0; s < names.size(); ++s){
+        const auto next = names[(s + 1) % names.size()];
+        fsm.add_state(names[s], {s}, [self = names[s], next]tr_lamba{
+            return name_to_state_id.at(inputs[0] == 1 ? next : self);
+        });
+    }
+    fsm.set_current_state("A");
+    fsm.set_input(0, 1);
+
+    //The transition into the removed state, whose name is no longer in the table, is invalid until a state with its name is added again
+    vector<size_t> old_to_new_state_id;
+    CHECK(fsm.remove_state("B", old_to_new_state_id) == 0);
+    CHECK(old_to_new_state_id == (vector<size_t>{0, static_cast<size_t>(-1), 1}));
+    CHECK(fsm.step_machine() == static_cast<size_t>(-1));
+    CHECK(fsm.get_current_state_name() == "A");
+
+    const auto new_b = fsm.add_state("B", {7}, [](const vector<size_t>& inputs, const symbol_table&, const symbol_table& name_to_state_id) -> size_t{
+        return name_to_state_id.at(inputs[0] == 1 ? "C" : "B");
+    });
+    CHECK(new_b == 2);
+    CHECK(fsm.step_machine() == new_b);
+    CHECK(fsm.get_outputs()[0] == 7);
+    CHECK(fsm.get_current_state_name() == "B");
+    CHECK(fsm.step_machine() == fsm.get_state_id("C"));
+    CHECK(fsm.step_machine() == fsm.get_state_id("A"));
+
+    //The same holds after the states are renumbered
+    fsm.compile();
+    const vector<size_t> sample_trace = {1, 1, 1, 0, 1};
+    CHECK(fsm.renumber_states(sample_trace, old_to_new_state_id) == 0);
+    for(const auto& name : {"B", "C", "A", "B"})
+        CHECK(fsm.get_state_name(fsm.step_machine()) == name);
+
+    //Bulk removal from random handle based machines, against the original machine
+    mt19937_64 rng(21);
+    const size_t num_states = 60;
+    for(const auto compiled : {false, true}){
+        vector<size_t> next(num_states * 3);
+        for(auto& next_state_id : next)
+            next_state_id = rng() % 15 == 0 ? static_cast<size_t>(-1) : rng() % num_states;
+        moore_fsm reference(1, 1);
+        reference.set_input_alphabet_size(0, 3);
+        for(size_t s = 0; s < num_states; ++s)
+            reference.add_state("s" + to_string(s), {s}, [s, next](input_view inputs) -> size_t{return next[s * 3 + inputs[0] % 3];});
+        if(compiled)
+            CHECK(reference.compile() == 0);
+        reference.set_current_state(0);
+
+        //An invalid id removes nothing
+        auto edited = reference;
+        vector<size_t> removed = {num_states - 1, 3, 17, 18, 40, 3};
+        removed.push_back(num_states);
+        CHECK(edited.remove_states(removed, old_to_new_state_id) == 1);
+        CHECK(edited.get_num_states() == num_states);
+        removed.pop_back();
+        CHECK(edited.remove_states(removed, old_to_new_state_id) == 0);
+        CHECK(edited.get_num_states() == num_states - 5);
+        CHECK(edited.is_compiled() == compiled);
+
+        for(size_t s = 0; s < num_states; ++s){
+            const bool is_removed = ranges::find(removed, s) != removed.end();
+            CHECK((old_to_new_state_id[s] == static_cast<size_t>(-1)) == is_removed);
+            if(!is_removed){
+                CHECK(edited.get_state_name(old_to_new_state_id[s]) == "s" + to_string(s));
+                CHECK(edited.get_state_outputs(old_to_new_state_id[s])[0] == s);
+            }
+            else
+                CHECK(edited.get_state_id("s" + to_string(s)) == static_cast<size_t>(-1));
+        }
+
+        //Every transition from a remaining state: the same one, or invalid if it went to a removed state
+        for(size_t s = 0; s < num_states; ++s){
+            if(old_to_new_state_id[s] == static_cast<size_t>(-1))
+                continue;
+            for(size_t input = 0; input < 4; ++input){
+                const auto next_state_id = reference.get_next_state(s, {input});
+                const auto expected = next_state_id < num_states ? old_to_new_state_id[next_state_id] : static_cast<size_t>(-1);
+                CHECK(edited.get_next_state(old_to_new_state_id[s], {input}) == expected);
+            }
+        }
+    }
+
+    if(num_failures == 0)
+        cout << "remove_states_test: ok" << endl;
+    return num_failures;
+}
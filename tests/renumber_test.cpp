@@ -0,0 +1,109 @@
+/*
+Checks that moore_fsm::renumber_states keeps the behaviour of the machine: machines mixing handle based and name based transition
+functions, compiled or not, are renumbered (twice, so that the translations compose) and stepped side by side with the original.
+*/
+
+#include <vector>
+#include <string>
+#include <random>
+#include <algorithm>
+#include "fsmlib.hpp"
+#include "check.hpp"
+
+using namespace std;
+
+//Random machine with one input of alphabet size 4, one transition in twelve invalid. Even states have handle based
+//transition functions returning captured ids, odd states name based ones looking the next state up by name.
+static moore_fsm make_machine(const size_t& num_states, mt19937_64& rng){
+    vector<size_t> next(num_states * 4);
+    for(auto& next_state_id : next)
+        next_state_id = rng() % 12 == 0 ? static_cast<size_t>(-1) : rng() % num_states;
+
+    moore_fsm fsm(1, 2);
+    fsm.set_input_alphabet_size(0, 4);
+    for(size_t s = 0; s < num_states; ++s){
+        if(s % 2 == 0)
+            fsm.add_state("s" + to_string(s), {s, s % 3}, [s, next](input_view inputs) -> size_t{return next[s * 4 + inputs[0] % 4];});
+        else
+            fsm.add_state("s" + to_string(s), {s, s % 3}, [s, next]tr_lamba -> size_t{
+                const auto next_state_id = next[s * 4 + inputs[0] % 4];
+                return next_state_id < next.size() / 4 ? name_to_state_id.at("s" + to_string(next_state_id)) : next_state_id;
+            });
+    }
+    fsm.set_current_state(0);
+    return fsm;
+}
+
+int main(){
+    mt19937_64 rng(20);
+    const size_t num_states = 80;
+
+    for(const auto compiled : {false, true}){
+        auto reference = make_machine(num_states, rng);
+        if(compiled)
+            CHECK(reference.compile() == 0);
+        auto renumbered = reference;
+
+        //Sample traces using only inputs 0 and 1, so that some states are never reached
+        vector<size_t> composed(num_states);
+        for(size_t s = 0; s < num_states; ++s)
+            composed[s] = s;
+        for(size_t round = 0; round < 2; ++round){
+            vector<size_t> sample_trace(500);
+            for(auto& input : sample_trace)
+                input = rng() % 2;
+            vector<size_t> old_to_new_state_id;
+            CHECK(renumbered.renumber_states(sample_trace, old_to_new_state_id) == 0);
+            CHECK(renumbered.is_compiled() == compiled);
+
+            //A permutation, which leaves the states never reached at the end in their original order
+            auto sorted = old_to_new_state_id;
+            ranges::sort(sorted);
+            for(size_t s = 0; s < num_states; ++s)
+                CHECK(sorted[s] == s);
+            for(auto& id : composed)
+                id = old_to_new_state_id[id];
+        }
+
+        for(size_t s = 0; s < num_states; ++s){
+            CHECK(renumbered.get_state_name(composed[s]) == reference.get_state_name(s));
+            CHECK(ranges::equal(renumbered.get_state_outputs(composed[s]), reference.get_state_outputs(s)));
+        }
+        CHECK(renumbered.get_current_state_id() == composed[reference.get_current_state_id()]);
+
+        //The same steps with all the inputs, including the transitions never taken by the sample traces
+        for(size_t k = 0; k < 20000; ++k){
+            const size_t input = rng() % 5;
+            reference.set_input(0, input);
+            renumbered.set_input(0, input);
+            const auto next_state_id = reference.step_machine();
+            CHECK(renumbered.step_machine() == (next_state_id < num_states ? composed[next_state_id] : next_state_id));
+            CHECK(renumbered.get_current_state_id() == composed[reference.get_current_state_id()]);
+            CHECK(ranges::equal(renumbered.get_outputs(), reference.get_outputs()));
+
+            //From any state
+            const auto state_id = rng() % num_states;
+            const auto next_from_state = reference.get_next_state(state_id, {input});
+            CHECK(renumbered.get_next_state(composed[state_id], {input}) == (next_from_state < num_states ? composed[next_from_state] : next_from_state));
+        }
+    }
+
+    //States never reached keep their relative order at the end
+    auto fsm = moore_fsm::from_transition_table({2}, 1, {0, 1, 2, 3, 4}, {1, 1, 0, 0, 1, 1, 1, 1, 1, 1});
+    fsm.set_current_state(0);
+    vector<size_t> old_to_new_state_id;
+    CHECK(fsm.renumber_states(vector<size_t>{0, 1, 0, 1}, old_to_new_state_id) == 0);
+    CHECK(old_to_new_state_id[2] == 2 && old_to_new_state_id[3] == 3 && old_to_new_state_id[4] == 4);
+    CHECK(fsm.get_outputs()[0] == 0);
+
+    //Invalid sample traces
+    moore_fsm two_inputs(2, 1);
+    two_inputs.add_state({0}, [](input_view) -> size_t{return 0;});
+    CHECK(two_inputs.renumber_states(vector<size_t>{0, 1, 0}, old_to_new_state_id) == 1);
+    moore_fsm empty(1, 1);
+    CHECK(empty.renumber_states(vector<size_t>{0}, old_to_new_state_id) == 1);
+
+    if(num_failures == 0)
+        cout << "renumber_test: ok" << endl;
+    return num_failures;
+}
@@ -0,0 +1,82 @@
+/*
+Checks that moore_fsm::run_events gives exactly the same results as moore_fsm::run, for every trace_mode and for traces
+hitting invalid transitions, and that step_machine(num_steps, num_elided_steps) doesn't elide the steps seen by a recorder or a profiler.
+*/
+
+#include <vector>
+#include <random>
+#include <algorithm>
+#include "fsmlib.hpp"
+#include "check.hpp"
+
+using namespace std;
+
+//Random handle based machine with one input of alphabet size 4: input 0 always loops, one transition in ten is invalid
+static moore_fsm make_machine(const size_t& num_states, mt19937_64& rng){
+    vector<size_t> next_states(num_states * 4);
+    for(auto& next_state_id : next_states)
+        next_state_id = rng() % 10 == 0 ? static_cast<size_t>(-1) : rng() % num_states;
+
+    moore_fsm fsm(1, 1);
+    fsm.set_input_alphabet_size(0, 4);
+    for(size_t s = 0; s < num_states; ++s)
+        fsm.add_state({s * 3}, [s, next_states](input_view inputs) -> size_t{
+            return inputs[0] == 0 ? s : next_states[s * 4 + inputs[0]];
+        });
+    fsm.set_current_state(0);
+    return fsm;
+}
+
+int main(){
+    mt19937_64 rng(25);
+
+    for(const size_t num_states : {1, 5, 40}){
+        for(const auto compiled : {false, true}){
+            //Long runs of equal inputs, with some single step changes
+            vector<size_t> trace(20000);
+            for(size_t k = 0; k < trace.size(); ++k)
+                trace[k] = rng() % 8 == 0 ? rng() % 4 : (k / 64) % 4;
+
+            for(const auto mode : {trace_mode::states, trace_mode::outputs, trace_mode::final_state}){
+                auto reference = make_machine(num_states, rng);
+                if(compiled)
+                    reference.compile();
+                auto events = reference;
+
+                const size_t output_size = mode == trace_mode::final_state ? 0 : trace.size();
+                vector<size_t> reference_trace(output_size, 12345), events_trace(output_size, 12345);
+                size_t num_elided_steps = 0;
+                CHECK(reference.run(trace, reference_trace, mode) == events.run_events(trace, events_trace, mode, num_elided_steps));
+                CHECK(reference_trace == events_trace);
+                CHECK(reference.get_current_state_id() == events.get_current_state_id());
+                CHECK(reference.get_inputs() == events.get_inputs());
+                CHECK(ranges::equal(reference.get_outputs(), events.get_outputs()));
+                CHECK(num_elided_steps > 0);
+            }
+        }
+    }
+
+    //With fixed inputs, step_machine skips the steps after a self-loop, and ends in the same state as the plain step_machine
+    auto reference = make_machine(12, rng);
+    auto events = reference;
+    reference.set_input(0, 0);
+    events.set_input(0, 0);
+    size_t num_elided_steps = 0;
+    CHECK(reference.step_machine(100) == events.step_machine(100, num_elided_steps));
+    CHECK(num_elided_steps == 99);
+    CHECK(reference.get_current_state_id() == events.get_current_state_id());
+
+    //A recorder or a profiler attached sees every step
+    transition_recorder recorder(1000, 1);
+    transition_profiler profiler;
+    events.attach_recorder(recorder);
+    events.attach_profiler(profiler);
+    CHECK(events.step_machine(100, num_elided_steps) == reference.get_current_state_id());
+    CHECK(num_elided_steps == 0);
+    CHECK(recorder.get_num_recorded() == 100);
+    CHECK(profiler.get_state_visits().at(reference.get_current_state_id()) == 100);
+
+    if(num_failures == 0)
+        cout << "run_events_test: ok" << endl;
+    return num_failures;
+}
@@ -0,0 +1,104 @@
+/*
+Checks that moore_fsm::run_parallel gives exactly the same results as moore_fsm::run, for every trace_mode,
+for traces split into different numbers of chunks, for traces hitting invalid transitions and for machines without a current state.
+*/
+
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <stdexcept>
+#include "fsmlib.hpp"
+#include "check.hpp"
+
+using namespace std;
+
+//Random tabulated machine with two inputs of alphabet size 3, one transition in twenty invalid
+static moore_fsm make_machine(const size_t& num_states, mt19937_64& rng){
+    const size_t num_encoded_inputs = 9;
+    vector<size_t> table(num_states * num_encoded_inputs);
+    for(auto& next_state_id : table)
+        next_state_id = rng() % 20 == 0 ? static_cast<size_t>(-1) : rng() % num_states;
+
+    vector<size_t> outputs(num_states * 2);
+    for(size_t s = 0; s < num_states; ++s){
+        outputs[2 * s] = s;
+        outputs[2 * s + 1] = s % 3;
+    }
+
+    auto fsm = moore_fsm::from_transition_table({3, 3}, 2, outputs, table);
+    fsm.set_current_state(num_states / 2);
+    return fsm;
+}
+
+int main(){
+    mt19937_64 rng(7);
+
+    for(const size_t num_threads : {1, 2, 3, 8}){
+        fsm_executor executor(num_threads);
+
+        //From a single chunk up to many chunks of 4096 steps, plus a trace that doesn't split evenly
+        for(const size_t num_steps : {100, 8192, 20000, 100003}){
+            for(const size_t num_states : {1, 7, 64}){
+                //Inputs of value 3 are outside of the alphabet, which makes the transition invalid as well
+                vector<size_t> trace(2 * num_steps);
+                for(auto& in : trace)
+                    in = rng() % 50 == 0 ? 3 : rng() % 3;
+
+                for(const auto mode : {trace_mode::states, trace_mode::outputs, trace_mode::final_state}){
+                    auto reference = make_machine(num_states, rng);
+                    auto parallel = reference;
+
+                    const size_t output_size = mode == trace_mode::outputs ? 2 * num_steps : mode == trace_mode::states ? num_steps : 0;
+                    vector<size_t> reference_trace(output_size, 12345), parallel_trace(output_size, 12345);
+
+                    const auto reference_result = reference.run(trace, reference_trace, mode);
+                    const auto parallel_result = parallel.run_parallel(executor, trace, parallel_trace, mode);
+                    CHECK(reference_result == parallel_result);
+                    CHECK(reference_trace == parallel_trace);
+                    CHECK(reference.get_current_state_id() == parallel.get_current_state_id());
+                    CHECK(reference.get_inputs() == parallel.get_inputs());
+                    CHECK(ranges::equal(reference.get_outputs(), parallel.get_outputs()));
+                }
+            }
+        }
+
+        //A machine whose current state has been removed has no state to start the chunks from
+        for(const auto mode : {trace_mode::states, trace_mode::outputs, trace_mode::final_state}){
+            const size_t num_steps = 100000;
+            vector<size_t> trace(2 * num_steps);
+            for(auto& in : trace)
+                in = rng() % 3;
+
+            auto reference = make_machine(16, rng);
+            vector<size_t> old_to_new_state_id;
+            CHECK(reference.remove_state(reference.get_current_state_id(), old_to_new_state_id) == 0);
+            CHECK(reference.get_current_state_id() == static_cast<size_t>(-1));
+            auto parallel = reference;
+
+            const size_t output_size = mode == trace_mode::outputs ? 2 * num_steps : mode == trace_mode::states ? num_steps : 0;
+            vector<size_t> reference_trace(output_size, 12345), parallel_trace(output_size, 12345);
+            const auto reference_result = reference.run(trace, reference_trace, mode);
+            CHECK(parallel.run_parallel(executor, trace, parallel_trace, mode) == reference_result);
+            CHECK(reference_trace == parallel_trace);
+            CHECK(reference.get_current_state_id() == parallel.get_current_state_id());
+        }
+
+        //Traces of the wrong size are rejected the same way
+        auto fsm = make_machine(8, rng);
+        vector<size_t> odd_trace(5), states(5);
+        CHECK(fsm.run_parallel(executor, odd_trace, states) == static_cast<size_t>(-1));
+
+        //Nested calls to the same executor are rejected instead of deadlocking
+        bool nested_rejected = false;
+        try {
+            executor.parallel_for(4, [&](const size_t&){executor.parallel_for(2, [](const size_t&){});});
+        } catch(const logic_error&) {
+            nested_rejected = true;
+        }
+        CHECK(nested_rejected);
+    }
+
+    if(num_failures == 0)
+        cout << "run_parallel_test: ok" << endl;
+    return num_failures;
+}
@@ -0,0 +1,114 @@
+/*
+Checks that moore_fsm::run_stream gives the same results as moore_fsm::run over the unpacked trace, for several record formats,
+reading from memory and from a file descriptor over more than one chunk, and that make_fd_sink writes the results as they are.
+*/
+
+#include <vector>
+#include <string>
+#include <random>
+#include <cstddef>
+#include <fstream>
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+#include "fsmlib.hpp"
+#include "check.hpp"
+
+using namespace std;
+
+//Reads num_bits bits at bit offset bit of the stream, little endian, one bit at a time
+static uint64_t read_field(const vector<byte>& data, const size_t& bit, const size_t& num_bits){
+    uint64_t value = 0;
+    for(size_t b = 0; b < num_bits; ++b)
+        value |= static_cast<uint64_t>((static_cast<unsigned>(data[(bit + b) / 8]) >> ((bit + b) % 8)) & 1) << b;
+    return value;
+}
+
+//Random handle based machine with two inputs, whose values are used modulo 7, one transition in twenty invalid
+static moore_fsm make_machine(mt19937_64& rng){
+    const size_t num_states = 30;
+    vector<size_t> next(num_states * 49);
+    for(auto& next_state_id : next)
+        next_state_id = rng() % 20 == 0 ? static_cast<size_t>(-1) : rng() % num_states;
+
+    moore_fsm fsm(2, 2);
+    for(size_t s = 0; s < num_states; ++s)
+        fsm.add_state({s, s * s}, [s, next](input_view inputs) -> size_t{return next[s * 49 + (inputs[0] % 7) * 7 + inputs[1] % 7];});
+    fsm.set_current_state(0);
+    return fsm;
+}
+
+int main(){
+    mt19937_64 rng(15);
+    const auto path = (filesystem::temp_directory_path() / "fsmlib_run_stream_test.bin").string();
+    const auto sink_path = (filesystem::temp_directory_path() / "fsmlib_run_stream_test_sink.bin").string();
+
+    for(const stream_format format : {stream_format{1, 0}, stream_format{3, 7}, stream_format{8, 0}, stream_format{16, 32}, stream_format{64, 0}}){
+        const auto record_bits = format.record_bits == 0 ? 2 * format.field_bits : format.record_bits;
+        const size_t num_records = 40000 + rng() % 100;
+
+        //Random bytes, whose length is not a multiple of the records, and the same trace unpacked bit by bit
+        vector<byte> data((num_records * record_bits + 7) / 8 + 1);
+        for(auto& d : data)
+            d = static_cast<byte>(rng());
+        vector<size_t> trace;
+        for(size_t r = 0; r < data.size() * 8 / record_bits; ++r)
+            for(size_t i = 0; i < 2; ++i)
+                trace.push_back(read_field(data, r * record_bits + i * format.field_bits, format.field_bits));
+
+        for(const auto mode : {trace_mode::states, trace_mode::outputs}){
+            auto reference = make_machine(rng);
+            auto from_memory = reference;
+            auto from_fd = reference;
+
+            const auto results_per_step = mode == trace_mode::outputs ? 2 : 1;
+            vector<size_t> expected(trace.size() / 2 * results_per_step);
+            reference.run(trace, expected, mode);
+
+            vector<size_t> collected;
+            const auto sink = [&](span<const size_t> results){
+                collected.insert(collected.end(), results.begin(), results.end());
+                return 0;
+            };
+            size_t num_steps = 0;
+            CHECK(from_memory.run_stream(data, format, mode, sink, num_steps) == 0);
+            CHECK(num_steps == trace.size() / 2);
+            CHECK(collected == expected);
+            CHECK(from_memory.get_current_state_id() == reference.get_current_state_id());
+
+            //The same from a file, with the results written by make_fd_sink
+            ofstream(path, ios::binary).write(reinterpret_cast<const char*>(data.data()), data.size());
+            const int in_fd = open(path.c_str(), O_RDONLY);
+            const int out_fd = open(sink_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            CHECK(from_fd.run_stream(in_fd, format, mode, make_fd_sink(out_fd, 4), num_steps) == 0);
+            close(in_fd);
+            close(out_fd);
+            CHECK(num_steps == trace.size() / 2);
+            CHECK(from_fd.get_current_state_id() == reference.get_current_state_id());
+
+            ifstream sink_file(sink_path, ios::binary);
+            vector<unsigned char> bytes((istreambuf_iterator<char>(sink_file)), {});
+            CHECK(bytes.size() == 4 * expected.size());
+            for(size_t k = 0; k < min(expected.size(), bytes.size() / 4); ++k){
+                const uint32_t value = bytes[4 * k] | bytes[4 * k + 1] << 8 | bytes[4 * k + 2] << 16 | static_cast<uint32_t>(bytes[4 * k + 3]) << 24;
+                CHECK(value == static_cast<uint32_t>(expected[k]));
+            }
+        }
+    }
+
+    //A sink asking to stop, and invalid formats
+    auto fsm = make_machine(rng);
+    vector<byte> data(100000);
+    size_t num_steps = 0;
+    CHECK(fsm.run_stream(data, {8, 0}, trace_mode::states, [](span<const size_t>){return 1;}, num_steps) == 3);
+    CHECK(fsm.run_stream(data, {0, 0}, trace_mode::states, [](span<const size_t>){return 0;}, num_steps) == 1);
+    CHECK(fsm.run_stream(data, {65, 0}, trace_mode::states, [](span<const size_t>){return 0;}, num_steps) == 1);
+    CHECK(fsm.run_stream(data, {8, 15}, trace_mode::states, [](span<const size_t>){return 0;}, num_steps) == 1);
+
+    filesystem::remove(path);
+    filesystem::remove(sink_path);
+
+    if(num_failures == 0)
+        cout << "run_stream_test: ok" << endl;
+    return num_failures;
+}
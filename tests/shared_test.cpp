@@ -0,0 +1,206 @@
+/*
+Checks that a moore_fsm_reader steps its definition exactly like a plain moore_fsm, that refresh carries the current state over
+following every state_migration policy, and that readers stepping in other threads while definitions are published always step
+a consistent definition, which is freed once no reader holds it.
+*/
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <string>
+#include <memory>
+#include <random>
+#include <algorithm>
+#include "fsmlib.hpp"
+#include "check.hpp"
+
+using namespace std;
+
+//Random handle based machine with num_inputs inputs, one transition in fifteen invalid. State s is named "s" + names[s]
+//and outputs names[s], so that the same names can be given to the states in another order
+static moore_fsm make_machine(const vector<size_t>& names, mt19937_64& rng, const size_t& num_inputs = 1){
+    const auto num_states = names.size();
+    vector<size_t> next(num_states * 3);
+    for(auto& next_state_id : next)
+        next_state_id = rng() % 15 == 0 ? static_cast<size_t>(-1) : rng() % num_states;
+
+    moore_fsm fsm(num_inputs, 1);
+    for(size_t s = 0; s < num_states; ++s)
+        fsm.add_state("s" + to_string(names[s]), {names[s]}, [s, next](input_view inputs) -> size_t{return next[s * 3 + inputs[0] % 3];});
+    fsm.set_current_state(0);
+    return fsm;
+}
+
+//Steps reader and a plain copy of its definition side by side from the current state of the reader
+static void check_steps_like_copy(moore_fsm_reader& reader, mt19937_64& rng, const size_t& num_steps){
+    auto reference = reader.get_definition();
+    reference.set_current_state(reader.get_current_state_id());
+    reference.set_inputs(reader.get_inputs());
+    for(size_t k = 0; k < num_steps; ++k){
+        const size_t input = rng() % 4;
+        reader.set_input(0, input);
+        reference.set_input(0, input);
+        CHECK(reader.step_machine() == reference.step_machine());
+        CHECK(reader.get_current_state_name() == reference.get_current_state_name());
+        CHECK(ranges::equal(reader.get_outputs(), reference.get_outputs()));
+    }
+}
+
+int main(){
+    mt19937_64 rng(22);
+    vector<size_t> names(30);
+    for(size_t s = 0; s < names.size(); ++s)
+        names[s] = s;
+
+    //The names shuffled, without "s29"
+    auto shuffled = names;
+    shuffle(shuffled.begin(), shuffled.end(), rng);
+    shuffled.erase(ranges::find(shuffled, 29));
+
+    //The reader starts from the current state of the definition, and steps and runs like a copy of it
+    {
+        auto reference = make_machine(names, rng);
+        reference.set_current_state(5);
+        shared_moore_fsm shared(reference);
+        moore_fsm_reader reader(shared);
+        CHECK(shared.get_version() == 1 && reader.get_version() == 1);
+        CHECK(reader.get_current_state_id() == 5);
+        CHECK(reader.get_inputs() == vector<size_t>{0});
+        check_steps_like_copy(reader, rng, 5000);
+
+        reference.set_current_state(reader.get_current_state_id());
+        reference.set_inputs(reader.get_inputs());
+        vector<size_t> trace(1000), reader_results(2000), reference_results(2000);
+        for(auto& input : trace)
+            input = rng() % 3;
+        for(const auto mode : {trace_mode::states, trace_mode::outputs}){
+            CHECK(reader.run(trace, reader_results, mode) == reference.run(trace, reference_results, mode));
+            CHECK(reader_results == reference_results);
+            CHECK(reader.get_current_state_id() == reference.get_current_state_id());
+        }
+        CHECK(reader.step_machine(0) == 0);
+        CHECK(reader.set_current_state(30) == 1 && reader.set_current_state("s30") == 1);
+        CHECK(reader.set_input(1, 0) == 1 && reader.get_output(1) == static_cast<size_t>(-1));
+
+        //Nothing published: refresh keeps everything
+        reader.set_current_state("s12");
+        reader.set_input(0, 2);
+        CHECK(reader.refresh() == 0);
+        CHECK(reader.get_current_state_id() == 12 && reader.get_inputs() == vector<size_t>{2});
+
+        //Until refresh, the reader keeps stepping the old definition, which is freed once the reader drops it
+        const weak_ptr<const moore_fsm> old_definition = shared.get_definition();
+        shared.publish(make_machine(shuffled, rng));
+        CHECK(shared.get_version() == 2 && reader.get_version() == 1);
+        CHECK(&reader.get_definition() == old_definition.lock().get());
+        check_steps_like_copy(reader, rng, 1000);
+        CHECK(!old_definition.expired());
+
+        reader.set_current_state("s12");
+        CHECK(reader.refresh() == 0);
+        CHECK(reader.get_version() == 2 && reader.get_current_state_name() == "s12");
+        CHECK(&reader.get_definition() == shared.get_definition().get());
+        CHECK(old_definition.expired());
+        check_steps_like_copy(reader, rng, 1000);
+    }
+
+    //Migration policies, from a state the new definition keeps and from the state it drops
+    for(const auto migration : {state_migration::by_name, state_migration::by_id, state_migration::reset}){
+        for(const size_t from_state_id : {size_t(12), size_t(29)}){
+            shared_moore_fsm shared(make_machine(names, rng));
+            moore_fsm_reader reader(shared, migration);
+            CHECK(reader.get_migration() == migration);
+            reader.set_current_state(from_state_id);
+            reader.set_input(0, 2);
+
+            auto next_definition = make_machine(shuffled, rng);
+            next_definition.set_current_state(3);
+            shared.publish(next_definition);
+
+            const auto ret_val = reader.refresh();
+            const bool kept = from_state_id != 29;
+            if(migration == state_migration::by_name){
+                CHECK(ret_val == (kept ? 0 : 1));
+                CHECK(kept ? reader.get_current_state_name() == "s12" : reader.get_current_state_id() == 3);
+            }
+            else if(migration == state_migration::by_id){
+                CHECK(ret_val == (kept ? 0 : 1));
+                CHECK(reader.get_current_state_id() == (kept ? from_state_id : 3));
+            }
+            else{
+                CHECK(ret_val == 0);
+                CHECK(reader.get_current_state_id() == 3);
+            }
+            CHECK(reader.get_inputs() == vector<size_t>{2});
+            check_steps_like_copy(reader, rng, 1000);
+        }
+    }
+
+    //Inputs added by the new definition start from 0, the others are kept
+    {
+        shared_moore_fsm shared(make_machine(names, rng));
+        moore_fsm_reader reader(shared, state_migration::by_id);
+        reader.set_input(0, 2);
+        shared.publish(make_machine(names, rng, 3));
+        CHECK(reader.refresh() == 0);
+        CHECK(reader.get_inputs() == (vector<size_t>{2, 0, 0}));
+        CHECK(reader.set_inputs({1, 1}) == 1 && reader.set_inputs({1, 1, 1, 1}) == 2);
+        check_steps_like_copy(reader, rng, 1000);
+    }
+
+    //Readers stepping in other threads while a writer publishes: every step follows the definition the reader holds,
+    //and versions only go forward
+    {
+        vector<mt19937_64> definition_rngs(200);
+        for(size_t v = 0; v < definition_rngs.size(); ++v)
+            definition_rngs[v].seed(1000 + v);
+        shared_moore_fsm shared(make_machine(names, definition_rngs[0]));
+        const weak_ptr<const moore_fsm> first_definition = shared.get_definition();
+
+        atomic<bool> done{false};
+        atomic<size_t> num_bad{0};
+        vector<thread> readers;
+        for(size_t r = 0; r < 4; ++r)
+            readers.emplace_back([&, r]{
+                mt19937_64 reader_rng(r);
+                moore_fsm_reader reader(shared, r % 2 == 0 ? state_migration::by_name : state_migration::by_id);
+                uint64_t last_version = reader.get_version();
+                vector<size_t> inputs(1);
+                while(!done.load()){
+                    for(size_t k = 0; k < 100; ++k){
+                        inputs[0] = reader_rng() % 4;
+                        reader.set_inputs(inputs);
+                        const auto from_state_id = reader.get_current_state_id();
+                        const auto expected = reader.get_definition().get_next_state(from_state_id, inputs);
+                        const auto next_state_id = reader.step_machine();
+                        if(next_state_id != (expected < reader.get_definition().get_num_states() ? expected : static_cast<size_t>(-1)))
+                            ++num_bad;
+                    }
+                    reader.refresh();
+                    if(reader.get_version() < last_version || reader.get_current_state_id() >= reader.get_definition().get_num_states())
+                        ++num_bad;
+                    last_version = reader.get_version();
+                }
+
+                //The last definition published is picked up
+                reader.refresh();
+                if(reader.get_version() != shared.get_version() || &reader.get_definition() != shared.get_definition().get())
+                    ++num_bad;
+            });
+
+        for(size_t v = 1; v < definition_rngs.size(); ++v){
+            shared.publish(make_machine(v % 2 == 0 ? names : shuffled, definition_rngs[v]));
+            this_thread::yield();
+        }
+        done = true;
+        for(auto& reader : readers)
+            reader.join();
+        CHECK(num_bad == 0);
+        CHECK(shared.get_version() == definition_rngs.size());
+        CHECK(first_definition.expired());
+    }
+
+    if(num_failures == 0)
+        cout << "shared_test: ok" << endl;
+    return num_failures;
+}
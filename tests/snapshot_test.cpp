@@ -0,0 +1,208 @@
+/*
+Checks that snapshots of moore_fsm and moore_fsm_bank restore the run state exactly: a machine or a bank restored into a freshly
+built copy keeps stepping like plain moore_fsm machines that were never saved, and snapshots that don't match the machine, are
+corrupted or can't be read are rejected without changing anything.
+*/
+
+#include <vector>
+#include <random>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <filesystem>
+#include "fsmlib.hpp"
+#include "check.hpp"
+
+using namespace std;
+
+//Random tabulated machine with inputs of alphabet sizes 3 and 4, one transition in fifteen invalid
+static moore_fsm make_machine(const size_t& num_states, mt19937_64& rng){
+    vector<size_t> table(num_states * 12);
+    for(auto& next_state_id : table)
+        next_state_id = rng() % 15 == 0 ? static_cast<size_t>(-1) : rng() % num_states;
+
+    vector<size_t> outputs(num_states);
+    for(size_t s = 0; s < num_states; ++s)
+        outputs[s] = s;
+
+    auto fsm = moore_fsm::from_transition_table({3, 4}, 1, outputs, table);
+    fsm.set_current_state(0);
+    return fsm;
+}
+
+static vector<size_t> random_inputs(mt19937_64& rng){
+    return {rng() % 3, rng() % 4};
+}
+
+int main(){
+    mt19937_64 rng(24);
+    const auto path = (filesystem::temp_directory_path() / "fsmlib_snapshot_test.bin").string();
+    const auto missing_path = (filesystem::temp_directory_path() / "fsmlib_snapshot_test_missing" / "snapshot.bin").string();
+    const size_t num_states = 50;
+    const auto fsm = make_machine(num_states, rng);
+
+    //A moore_fsm restored from a buffer and from a file steps like the machine that was saved
+    {
+        auto reference = fsm;
+        for(size_t k = 0; k < 1000; ++k){
+            reference.set_inputs(random_inputs(rng));
+            reference.step_machine();
+        }
+
+        vector<byte> buffer(reference.get_snapshot_size());
+        vector<byte> small(buffer.size() - 1);
+        CHECK(reference.save_snapshot(small) == 1);
+        CHECK(reference.save_snapshot(buffer) == 0);
+        CHECK(reference.save_snapshot(path) == 0);
+        CHECK(filesystem::file_size(path) == buffer.size());
+
+        auto from_buffer = fsm;
+        auto from_file = fsm;
+        from_buffer.set_current_state(7);
+        CHECK(from_buffer.load_snapshot(buffer) == 0);
+        CHECK(from_file.load_snapshot(path) == 0);
+        for(const auto* const restored : {&from_buffer, &from_file}){
+            CHECK(restored->get_current_state_id() == reference.get_current_state_id());
+            CHECK(restored->get_inputs() == reference.get_inputs());
+            CHECK(ranges::equal(restored->get_outputs(), reference.get_outputs()));
+        }
+
+        for(size_t k = 0; k < 5000; ++k){
+            //Keep the inputs of the snapshot for a few steps
+            if(k > 10){
+                const auto inputs = random_inputs(rng);
+                reference.set_inputs(inputs);
+                from_buffer.set_inputs(inputs);
+                from_file.set_inputs(inputs);
+            }
+            const auto next_state_id = reference.step_machine();
+            CHECK(from_buffer.step_machine() == next_state_id);
+            CHECK(from_file.step_machine() == next_state_id);
+            CHECK(ranges::equal(from_file.get_outputs(), reference.get_outputs()));
+        }
+
+        //Snapshots of machines with other numbers of states or inputs, corrupted or truncated, are rejected
+        auto target = fsm;
+        target.set_current_state(3);
+        target.set_inputs({2, 1});
+        const auto check_unchanged = [&]{
+            CHECK(target.get_current_state_id() == 3);
+            CHECK(target.get_inputs() == (vector<size_t>{2, 1}));
+        };
+
+        auto other_states = make_machine(num_states + 1, rng);
+        vector<byte> other_buffer(other_states.get_snapshot_size());
+        other_states.save_snapshot(other_buffer);
+        CHECK(target.load_snapshot(other_buffer) == 1);
+        check_unchanged();
+
+        moore_fsm one_input(1, 1);
+        for(size_t s = 0; s < num_states; ++s)
+            one_input.add_state({s}, [](input_view) -> size_t{return 0;});
+        one_input.set_current_state(0);
+        other_buffer.assign(one_input.get_snapshot_size(), byte{0});
+        one_input.save_snapshot(other_buffer);
+        CHECK(target.load_snapshot(other_buffer) == 1);
+        check_unchanged();
+
+        auto corrupted = buffer;
+        const uint64_t invalid_state_id = num_states;
+        memcpy(corrupted.data() + corrupted.size() - 3 * sizeof(uint64_t), &invalid_state_id, sizeof(invalid_state_id));
+        CHECK(target.load_snapshot(corrupted) == 1);
+        check_unchanged();
+        corrupted = buffer;
+        corrupted[0] = byte{'X'};
+        CHECK(target.load_snapshot(corrupted) == 1);
+        check_unchanged();
+        CHECK(target.load_snapshot(span<const byte>(buffer).first(buffer.size() - 1)) == 1);
+        check_unchanged();
+
+        //Files that can't be read or written
+        CHECK(target.load_snapshot(missing_path) == 3);
+        check_unchanged();
+        CHECK(target.save_snapshot(missing_path) == 2);
+    }
+
+    //A moore_fsm_bank restored from a buffer and from a file keeps stepping like one plain moore_fsm per instance
+    {
+        const size_t num_instances = 101;
+        moore_fsm_bank bank(fsm, num_instances);
+        vector<moore_fsm> references(num_instances, fsm);
+        const auto step = [&](vector<moore_fsm_bank*> banks){
+            for(size_t i = 0; i < num_instances; ++i){
+                if(rng() % 4 != 0)
+                    continue;
+                const auto inputs = random_inputs(rng);
+                references[i].set_inputs(inputs);
+                for(auto* const b : banks)
+                    b->set_inputs(i, inputs);
+            }
+            for(auto* const b : banks)
+                b->step_all();
+            for(auto& reference : references)
+                reference.step_machine();
+        };
+        for(size_t k = 0; k < 200; ++k)
+            step({&bank});
+
+        vector<byte> buffer(bank.get_snapshot_size());
+        CHECK(bank.save_snapshot(span<byte>(buffer).first(buffer.size() - 1)) == 1);
+        CHECK(bank.save_snapshot(buffer) == 0);
+        CHECK(bank.save_snapshot(path) == 0);
+
+        moore_fsm_bank from_buffer(fsm, num_instances);
+        moore_fsm_bank from_file(fsm, num_instances);
+        CHECK(from_buffer.load_snapshot(buffer) == 0);
+        CHECK(from_file.load_snapshot(path) == 0);
+        for(size_t k = 0; k < 300; ++k){
+            step({&from_buffer, &from_file});
+            for(size_t i = 0; i < num_instances; ++i){
+                CHECK(from_buffer.get_current_state_id(i) == references[i].get_current_state_id());
+                CHECK(from_file.get_current_state_id(i) == references[i].get_current_state_id());
+                CHECK(ranges::equal(from_file.get_outputs(i), references[i].get_outputs()));
+            }
+        }
+
+        //Snapshots of banks with another number of instances, of a single machine, or holding values out of range are rejected
+        moore_fsm_bank target(fsm, num_instances);
+        target.set_current_state(5, 9);
+        target.set_inputs(5, {2, 3});
+        const vector<uint32_t> state_ids(target.get_current_state_ids().begin(), target.get_current_state_ids().end());
+        const auto check_unchanged = [&]{
+            CHECK(ranges::equal(target.get_current_state_ids(), state_ids));
+            CHECK(target.get_input(5, 0) == 2 && target.get_input(5, 1) == 3);
+        };
+
+        moore_fsm_bank smaller(fsm, num_instances - 1);
+        vector<byte> other_buffer(smaller.get_snapshot_size());
+        smaller.save_snapshot(other_buffer);
+        CHECK(target.load_snapshot(other_buffer) == 1);
+        check_unchanged();
+        other_buffer.assign(fsm.get_snapshot_size(), byte{0});
+        fsm.save_snapshot(other_buffer);
+        CHECK(target.load_snapshot(other_buffer) == 1);
+        check_unchanged();
+
+        //The last instance gets an invalid state, then invalid encoded inputs: the instances before it are not overwritten either
+        const auto header_size = buffer.size() - (num_instances * 2 * sizeof(uint32_t) + 7) / 8 * 8;
+        const uint32_t invalid_value = 1000;
+        auto corrupted = buffer;
+        memcpy(corrupted.data() + header_size + (num_instances - 1) * sizeof(uint32_t), &invalid_value, sizeof(invalid_value));
+        CHECK(target.load_snapshot(corrupted) == 1);
+        check_unchanged();
+        corrupted = buffer;
+        memcpy(corrupted.data() + header_size + (2 * num_instances - 1) * sizeof(uint32_t), &invalid_value, sizeof(invalid_value));
+        CHECK(target.load_snapshot(corrupted) == 1);
+        check_unchanged();
+
+        CHECK(target.load_snapshot(missing_path) == 3);
+        check_unchanged();
+        CHECK(target.save_snapshot(missing_path) == 2);
+    }
+
+    filesystem::remove(path);
+
+    if(num_failures == 0)
+        cout << "snapshot_test: ok" << endl;
+    return num_failures;
+}
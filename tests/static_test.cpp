@@ -0,0 +1,69 @@
+/*
+Checks that a static_moore_fsm steps exactly like a moore_fsm built from the same transition table, with inputs in and out of
+their alphabets and invalid transitions, and that it can be evaluated at compile time.
+*/
+
+#include <array>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include "fsmlib.hpp"
+#include "check.hpp"
+
+using namespace std;
+
+//Two inputs of alphabet sizes 2 and 3, some transitions invalid
+constexpr size_t next_of(const size_t& state_id, const array<size_t, 2>& inputs){
+    if((state_id + inputs[0] + 2 * inputs[1]) % 11 == 0)
+        return -1;
+    return (state_id * 7 + inputs[0] * 3 + inputs[1] * 5 + 1) % 20;
+}
+constexpr auto table = make_static_fsm_table<20, 6, 2, 2>({2, 3},
+    [](size_t state_id) -> array<size_t, 2>{return {state_id, state_id % 3};},
+    [](size_t state_id, const array<size_t, 2>& inputs) -> size_t{return next_of(state_id, inputs);});
+
+//The whole simulation at compile time
+constexpr size_t static_run(){
+    static_moore_fsm<table> fsm(4);
+    fsm.set_inputs({1, 2});
+    fsm.step_machine(3);
+    fsm.set_input(0, 0);
+    fsm.step_machine();
+    return fsm.get_current_state_id();
+}
+static_assert(static_run() < 20);
+static_assert(static_moore_fsm<table>::get_num_states() == 20 && static_moore_fsm<table>::get_num_inputs() == 2);
+
+int main(){
+    vector<size_t> flat_table, outputs;
+    for(size_t s = 0; s < 20; ++s){
+        flat_table.insert(flat_table.end(), table.next_state[s].begin(), table.next_state[s].end());
+        outputs.insert(outputs.end(), table.state_outputs[s].begin(), table.state_outputs[s].end());
+    }
+    auto reference = moore_fsm::from_transition_table({2, 3}, 2, outputs, flat_table);
+    reference.set_current_state(4);
+    static_moore_fsm<table> fsm(4);
+
+    mt19937_64 rng(9);
+    for(size_t k = 0; k < 20000; ++k){
+        //One step in ten has an input outside of its alphabet, which makes the transition invalid in both
+        const array<size_t, 2> inputs = {rng() % (rng() % 10 == 0 ? 4 : 2), rng() % 3};
+        CHECK(fsm.set_inputs(inputs) == 0);
+        reference.set_inputs({inputs[0], inputs[1]});
+
+        const size_t num_steps = rng() % 3;
+        CHECK(fsm.step_machine(num_steps) == reference.step_machine(num_steps));
+        CHECK(fsm.get_current_state_id() == reference.get_current_state_id());
+        CHECK(ranges::equal(fsm.get_outputs(), reference.get_outputs()));
+        CHECK(fsm.get_output(1) == reference.get_output(1));
+    }
+
+    CHECK(fsm.step_machine(0) == 0);
+    CHECK(fsm.set_input(2, 0) != 0);
+    CHECK(fsm.get_output(2) == static_cast<size_t>(-1));
+    CHECK(fsm.set_current_state(20) != 0);
+
+    if(num_failures == 0)
+        cout << "static_test: ok" << endl;
+    return num_failures;
+}
@@ -0,0 +1,129 @@
+/*
+Checks symbol_table against a naive model built on std::map, with random renames, aliases, names taken from other ids and remaps,
+and that the names of a moore_fsm resolve the same ids before and after the machine is edited.
+*/
+
+#include <map>
+#include <vector>
+#include <string>
+#include <random>
+#include <algorithm>
+#include <stdexcept>
+#include "fsmlib.hpp"
+#include "check.hpp"
+
+using namespace std;
+
+//The rules of symbol_table, written in the most direct way
+struct naive_table {
+    map<string, size_t> name_to_id;
+    vector<string> id_to_name;
+
+    void take(const string& name, const size_t& id){
+        const auto it = name_to_id.find(name);
+        if(it != name_to_id.end() && it->second < id_to_name.size() && id_to_name[it->second] == name)
+            id_to_name[it->second].clear();
+        name_to_id[name] = id;
+    }
+    void set_name(const size_t& id, const string& name){
+        if(id >= id_to_name.size())
+            id_to_name.resize(id + 1);
+        if(!id_to_name[id].empty() && name_to_id.count(id_to_name[id]) && name_to_id[id_to_name[id]] == id)
+            name_to_id.erase(id_to_name[id]);
+        take(name, id);
+        id_to_name[id] = name;
+    }
+    void add_alias(const size_t& id, const string& name){
+        if(id >= id_to_name.size())
+            id_to_name.resize(id + 1);
+        take(name, id);
+        if(id_to_name[id].empty())
+            id_to_name[id] = name;
+    }
+    void remap(const vector<size_t>& old_to_new_id, const size_t& new_num_ids){
+        vector<string> new_id_to_name(new_num_ids);
+        for(size_t id = 0; id < id_to_name.size(); ++id)
+            if(old_to_new_id[id] < new_num_ids)
+                new_id_to_name[old_to_new_id[id]] = id_to_name[id];
+        map<string, size_t> new_name_to_id;
+        for(const auto& [name, id] : name_to_id)
+            if(old_to_new_id[id] < new_num_ids)
+                new_name_to_id[name] = old_to_new_id[id];
+        name_to_id = new_name_to_id;
+        id_to_name = new_id_to_name;
+    }
+};
+
+int main(){
+    mt19937_64 rng(7);
+
+    symbol_table table;
+    naive_table model;
+    size_t num_ids = 50;
+    for(size_t k = 0; k < 20000; ++k){
+        //Few distinct names, so that they are often taken from other ids
+        const auto id = rng() % num_ids;
+        const auto name = "n" + to_string(rng() % 80);
+        switch(rng() % 10){
+            case 0:
+                table.add_alias(id, name);
+                model.add_alias(id, name);
+                break;
+            case 1: {
+                //Random permutation dropping some ids
+                vector<size_t> old_to_new_id(num_ids);
+                for(size_t i = 0; i < num_ids; ++i)
+                    old_to_new_id[i] = i;
+                shuffle(old_to_new_id.begin(), old_to_new_id.end(), rng);
+                const auto new_num_ids = num_ids - rng() % 3;
+                table.remap(old_to_new_id, new_num_ids);
+                model.remap(old_to_new_id, new_num_ids);
+                num_ids = new_num_ids < 10 ? 50 : new_num_ids;
+                break;
+            }
+            default:
+                table.set_name(id, name);
+                model.set_name(id, name);
+        }
+
+        CHECK(table.size() == model.name_to_id.size());
+        for(size_t i = 0; i < model.id_to_name.size(); ++i)
+            CHECK(table.get_name(i) == model.id_to_name[i]);
+        for(size_t n = 0; n < 80; ++n){
+            const auto probe = "n" + to_string(n);
+            const auto it = model.name_to_id.find(probe);
+            CHECK(table.contains(probe) == (it != model.name_to_id.end()));
+            CHECK(table.get_id(probe) == (it != model.name_to_id.end() ? it->second : static_cast<size_t>(-1)));
+        }
+        if(num_failures > 10)
+            break;
+    }
+    for(const auto& [name, id] : table)
+        CHECK(model.name_to_id.at(name) == id);
+    CHECK(table.get_name(1000).empty());
+
+    bool thrown = false;
+    try {
+        table.at("missing");
+    } catch(const out_of_range&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+
+    //In a machine, the names follow the states through renames and removals
+    moore_fsm fsm(1, 1);
+    for(size_t s = 0; s < 1000; ++s)
+        fsm.add_state("s" + to_string(s), {s}, [s](input_view) -> size_t{return s;});
+    CHECK(fsm.get_state_id("s999") == 999);
+    CHECK(fsm.set_state_name(10, "ten") == 0);
+    CHECK(fsm.get_state_id("s10") == static_cast<size_t>(-1) && fsm.get_state_id("ten") == 10);
+    vector<size_t> old_to_new_state_id;
+    CHECK(fsm.remove_state(5, old_to_new_state_id) == 0);
+    CHECK(fsm.get_state_id("ten") == 9 && fsm.get_state_name(9) == "ten");
+    CHECK(fsm.get_state_id("s5") == static_cast<size_t>(-1) && fsm.get_state_id("s999") == 998);
+    CHECK(fsm.set_input_name(0, "in") == 0 && fsm.get_input_id("in") == 0 && fsm.get_input_name(0) == "in");
+
+    if(num_failures == 0)
+        cout << "symbol_table_test: ok" << endl;
+    return num_failures;
+}